@@ -4,722 +4,455 @@
 #define _SSS_START_LEVEL (_inverse ? HIGH : LOW)
 #define _SSS_STOP_LEVEL  (_inverse ? LOW : HIGH)
 #define CTS_ASSERTED     (_inverse ? (digitalRead(_ctsPin) == HIGH) : (digitalRead(_ctsPin) == LOW))
+#define _SSS_RTS_GO      (_inverse ? HIGH : LOW)     // RTS asserted
+#define _SSS_RTS_WAIT    (_inverse ? LOW : HIGH)     // RTS negated
+
+// Parity of every possible character, one bit each: 1 if the character has
+// an odd number of 1 bits. Shared by all the ports; each port only needs to
+// know what to OR in for odd and even characters. (A whole table of framed
+// characters for each port would take 512 bytes apiece.)
+static const uint8_t _sss_odd_parity[32] = {
+    0x96, 0x69, 0x69, 0x96, 0x69, 0x96, 0x96, 0x69, 0x69, 0x96, 0x96, 0x69, 0x96, 0x69, 0x69, 0x96,
+    0x69, 0x96, 0x96, 0x69, 0x96, 0x69, 0x69, 0x96, 0x96, 0x69, 0x69, 0x96, 0x69, 0x96, 0x96, 0x69,
+};
+
+static inline int _sss_parity_is_odd(uint8_t chr) {
+    return (_sss_odd_parity[chr >> 3] >> (chr & 7)) & 0x01;
+}
+
+// Words longer than 8 bits are just two characters' worth of parity.
+static inline int _sss_word_parity_is_odd(uint16_t word) {
+    return _sss_parity_is_odd(word & 0xFF) ^ _sss_parity_is_odd(word >> 8);
+}
+
+// Events scheduled on the shared timer
+#define _SSS_EVENT_TX       0
+#define _SSS_EVENT_RX       1
 
-// Operations of receive processing. These go in the op table to schedule
-// processing that occurs on receive timer interrupts. See design notes.
-#define _SSS_OP_NULL        0
-#define _SSS_OP_START       1
-#define _SSS_OP_CLEAR       2
-#define _SSS_OP_VOTE0       3
-#define _SSS_OP_VOTE1       4
-#define _SSS_OP_SHIFT       5
-#define _SSS_OP_STOP        6
-#define _SSS_OP_FINAL       7
+// Receive states in single timer mode
+#define _SSS_SINGLE_RX_IDLE     0   // waiting for a start bit interrupt
+#define _SSS_SINGLE_RX_PENDING  1   // start bit seen since the last tick
+#define _SSS_SINGLE_RX_ACTIVE   2   // stepping through the op table
 
 // Well, this is ugly. I need to be able to use callback functions for both
 // the IntervalTimer and the pin change interrupt. These cannot be member
 // functions, unless they are static, and static member functions can't
 // access the instance members. Thanks, C++.
-// We can tolerate a limitation to only a single serial port, reluctantly,
-// so we can save a pointer to the single instance here. That way a static
-// member function (the "trampoline") can invoke a non-static member
-// callback function.
-// The limitation to a single serial port is not too severe, since each
-// serial port uses up two precious timers. Teensy processors have either
-// two or four timers, so the best we could do would be two serial ports
-// anyway. That capability could be added.
-
-SlowSoftSerial *instance_p = NULL;
-int SlowSoftSerial::_active_count = 0;    // don't allow more than 1
-
-// Forward.
-static void _rx_start_trampoline(void);
-static void _rx_timer_trampoline(void);
-static void _tx_trampoline(void);
-
-///////////////////////////////////////////////////////////////////////
-//  Public Member Functions
-///////////////////////////////////////////////////////////////////////
-
-SlowSoftSerial::SlowSoftSerial(uint8_t rxPin, uint8_t txPin, bool inverse) {
-    _rxPin = rxPin;
-    _txPin = txPin;
-    _inverse = inverse;
-    _instance_active = false;
+// So, each active instance claims a slot in a small table of instance
+// pointers, and each slot gets its own set of static functions (the
+// "trampolines") that invoke the non-static member callback functions
+// for the instance in that slot. The trampolines are stamped out by a
+// template, one set per slot, so there's no searching at interrupt time.
+// The number of ports that can actually run at the same time is limited
+// by the number of timers, not by this table.
+
+static SlowSoftSerial *_sss_instances[_SSS_MAX_INSTANCES];
+
+template <int N> static void _tx_trampoline(void) {
+    _sss_instances[N]->_tx_handler();
 }
 
+template <int N> static void _rx_timer_trampoline(void) {
+    _sss_instances[N]->_rx_timer_handler();
+}
 
-void SlowSoftSerial::begin(double baudrate, uint16_t config) {
-    if (_active_count > 0) {
-        return;
-    }
-
-    _tx_timer.end();     // just in case begin is called out of sequence
-
-    if (baudrate < _SSS_MIN_BAUDRATE) {
-        return;
-    }
-    _tx_microseconds = 1000000.0/baudrate;  // 1x baud rate; will be halved in 1.5 stop bit case
-    _rx_microseconds = 250000.0/baudrate;   // 4x baud rate
-
-    _tx_halfbaud = 0;   // flag; will be set in 1.5 stop bit cases
-
-    switch (config) {
-        case SSS_SERIAL_5N1:
-            _num_bits_to_send = 6;
-            _stop_bits = 0x20;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x10;
-            _fill_op_table(5,SSS_SERIAL_STOP_BIT_1);
-            break;
-
-        case SSS_SERIAL_6N1:
-            _num_bits_to_send = 7;
-            _stop_bits = 0x40;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1);
-            break;
-
-        case SSS_SERIAL_7N1:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x80;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1);
-            break;
-
-        case SSS_SERIAL_8N1:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x100;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1);
-            break;
-
-        case SSS_SERIAL_5N2:
-            _num_bits_to_send = 7;
-            _stop_bits = 0x60;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x10;
-            _fill_op_table(5,SSS_SERIAL_STOP_BIT_2);
-            break;
+template <int N> static void _rx_start_trampoline(void) {
+    _sss_instances[N]->_rx_start_handler();
+}
 
-        case SSS_SERIAL_6N2:
-            _num_bits_to_send = 8;
-            _stop_bits = 0xC0;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_2);
-            break;
+template <int N> static void _single_trampoline(void) {
+    _sss_instances[N]->_single_handler();
+}
 
-        case SSS_SERIAL_7N2:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x180;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_2);
-            break;
+template <int N> static void _rx_edge_trampoline(void) {
+    _sss_instances[N]->_rx_edge_handler();
+}
 
-        case SSS_SERIAL_8N2:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x300;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_2);
-            break;
+template <int N> static void _rx_decode_trampoline(void) {
+    _sss_instances[N]->_rx_decode_handler();
+}
 
-        case SSS_SERIAL_5E1:
-            _num_bits_to_send = 7;
-            _stop_bits = 0x40;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1);
-            break;
+typedef void (*_sss_callback_t)(void);
+
+static const struct {
+    _sss_callback_t tx;
+    _sss_callback_t rx_timer;
+    _sss_callback_t rx_start;
+    _sss_callback_t single;
+    _sss_callback_t rx_edge;
+    _sss_callback_t rx_decode;
+} _sss_trampolines[_SSS_MAX_INSTANCES] = {
+#define _SSS_TRAMPOLINES(n) { _tx_trampoline<n>, _rx_timer_trampoline<n>, _rx_start_trampoline<n>, \
+                              _single_trampoline<n>, _rx_edge_trampoline<n>, _rx_decode_trampoline<n> }
+    _SSS_TRAMPOLINES(0), _SSS_TRAMPOLINES(1), _SSS_TRAMPOLINES(2), _SSS_TRAMPOLINES(3),
+    _SSS_TRAMPOLINES(4), _SSS_TRAMPOLINES(5), _SSS_TRAMPOLINES(6), _SSS_TRAMPOLINES(7),
+#undef _SSS_TRAMPOLINES
+};
+
+static_assert(_SSS_MAX_INSTANCES == 8, "add or remove _SSS_TRAMPOLINES() above to match _SSS_MAX_INSTANCES");
+
+// Used only to find out whether a timer is available
+static void _sss_probe_callback(void) {
+}
 
-        case SSS_SERIAL_6E1:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x80;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1);
-            break;
+#define _TX_TRAMPOLINE       (_sss_trampolines[_slot].tx)
+#define _RX_TIMER_TRAMPOLINE (_sss_trampolines[_slot].rx_timer)
+#define _RX_START_TRAMPOLINE (_sss_trampolines[_slot].rx_start)
+#define _SINGLE_TRAMPOLINE   (_sss_trampolines[_slot].single)
+#define _RX_EDGE_TRAMPOLINE  (_sss_trampolines[_slot].rx_edge)
+#define _RX_DECODE_TRAMPOLINE (_sss_trampolines[_slot].rx_decode)
+
+// The shared timer mode keeps its deadlines in CPU cycles, and the edge
+// timestamp receive mode keeps its timestamps in CPU cycles, as counted by
+// the ARM cycle counter.
+#if defined(__IMXRT1062__)
+#define _SSS_CYCLES_PER_SECOND (F_CPU_ACTUAL)
+#else
+#define _SSS_CYCLES_PER_SECOND (F_CPU)
+#endif
+
+// IntervalTimer counts ticks of the PIT clock, which is the 24 MHz crystal
+// on Teensy 4.x and the bus clock on Teensy 3.x.
+#if defined(__IMXRT1062__)
+#define _SSS_TIMER_TICKS_PER_SECOND (24000000)
+#else
+#define _SSS_TIMER_TICKS_PER_SECOND (F_BUS)
+#endif
+
+// IntervalTimer only takes microseconds, and rounds them to the nearest
+// tick, so this gets us exactly the number of ticks we asked for.
+static inline float _sss_ticks_to_us(uint32_t ticks) {
+    return (float)ticks / (float)(_SSS_TIMER_TICKS_PER_SECOND / 1000000);
+}
 
-        case SSS_SERIAL_7E1:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x100;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1);
-            break;
+static void _sss_enable_cycle_counter(void) {
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+}
 
-        case SSS_SERIAL_8E1:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x200;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_1);
-            break;
+// Adjust an op table to allow for seeing the start bit late, by up to one
+// sample time. That happens when start bits are found by a timer that's
+// already running for some other reason (the sampler, or single timer mode).
+// Each time it's applied, the FINAL op moves one sample earlier, so it must
+// only be applied once to any table. The format's rx_late_start (and the
+// port's _rx_late_start) says whether it has been.
+static void _sss_late_start_op_table(uint8_t *table, const uint8_t *port_table) {
+    int i;
+
+    for (i=0; i < _SSS_MAX_OPTABLE_SIZE; i++) {
+        table[i] = port_table[i];
+        if (i > 0 && port_table[i] == _SSS_OP_CLEAR && port_table[i-1] == _SSS_OP_START) {
+            table[i-1] = _SSS_OP_NULL;
+        } else if (i > 0 && port_table[i] == _SSS_OP_SHIFT && port_table[i-1] == _SSS_OP_VOTE1) {
+            table[i-1] = _SSS_OP_NULL;
+        } else if (i > 0 && port_table[i] == _SSS_OP_DECIDE && port_table[i-1] == _SSS_OP_COUNT1) {
+            table[i-1] = _SSS_OP_NULL;
+        } else if (i > 0 && port_table[i] == _SSS_OP_FINAL && port_table[i-1] == _SSS_OP_STOP) {
+            table[i-1] = _SSS_OP_FINAL;
+            table[i] = _SSS_OP_NULL;
+        }
+    }
+}
 
-        case SSS_SERIAL_5E2:
-            _num_bits_to_send = 8;
-            _stop_bits = 0xC0;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_2);
-            break;
+// Bytes of memory for a ring buffer of so many characters, each with so
+// many bits of flags stored after the buffer itself.
+#define _SSS_RING_BYTES(chars, flag_bits) \
+    ((chars) * sizeof(sss_buffer_word_t) + ((chars) * (flag_bits) + 7) / 8)
+
+// Find the biggest ring buffer that fits in the memory we're given.
+// It has to be aligned for the buffer words and hold a power of two characters.
+static sss_buffer_word_t *_sss_ring_memory(void *buffer, size_t size, int flag_bits, uint32_t *mask) {
+    uintptr_t align = sizeof(sss_buffer_word_t) - 1;
+    uintptr_t start = ((uintptr_t)buffer + align) & ~align;
+    size_t skip = start - (uintptr_t)buffer;
+    uint32_t ring = 1;
+
+    if (buffer == NULL || size < skip + _SSS_RING_BYTES(1, flag_bits)) {
+        return NULL;
+    }
 
-        case SSS_SERIAL_6E2:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x180;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_2);
-            break;
+    size -= skip;
+    while (_SSS_RING_BYTES(ring * 2, flag_bits) <= size) {
+        ring *= 2;
+    }
 
-        case SSS_SERIAL_7E2:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x300;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_2);
-            break;
+    *mask = ring - 1;
+    return (sss_buffer_word_t *)start;
+}
 
-        case SSS_SERIAL_8E2:
-            _num_bits_to_send = 11;
-            _stop_bits = 0x600;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_2);
-            break;
+#ifdef SSS_BUFFER_POOL_SIZE
+// The buffer pool, and the blocks of it lent out to active ports, in order
+// of their offsets into the pool. Each port borrows at most two blocks.
+#define _SSS_POOL_BLOCKS (2 * _SSS_MAX_INSTANCES)
+
+static uint32_t _sss_pool[(SSS_BUFFER_POOL_SIZE + 3) / 4];
+static uint32_t _sss_pool_offset[_SSS_POOL_BLOCKS];     // in bytes
+static uint32_t _sss_pool_bytes[_SSS_POOL_BLOCKS];
+static int _sss_pool_count;
+
+// Stands in for the buffers of a port that hasn't borrowed any, so the
+// pointers are never NULL. Nothing should ever be stored here: an inactive
+// port refuses writes, and its buffers are empty when they're given back.
+static sss_buffer_word_t _sss_no_buffer[1];
+#ifdef SSS_COMPACT_BUFFERS
+static uint8_t _sss_no_flags[1];
+#endif
+
+// Lend out the first gap between blocks that's big enough, if any.
+static void *_sss_pool_take(uint32_t bytes) {
+    uint32_t gap_start = 0;
+    uint32_t gap_end;
+    int i, j;
+
+    bytes = (bytes + 3) & ~3ul;     // keep every block word aligned
+    if (_sss_pool_count >= _SSS_POOL_BLOCKS) {
+        return NULL;
+    }
 
-        case SSS_SERIAL_5O1:
-            _num_bits_to_send = 7;
-            _stop_bits = 0x40;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1);
-           break;
-
-        case SSS_SERIAL_6O1:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x80;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1);
-            break;
+    for (i=0; i <= _sss_pool_count; i++) {
+        gap_end = (i < _sss_pool_count) ? _sss_pool_offset[i] : sizeof(_sss_pool);
+        if (gap_end - gap_start >= bytes) {
+            for (j=_sss_pool_count; j > i; j--) {
+                _sss_pool_offset[j] = _sss_pool_offset[j-1];
+                _sss_pool_bytes[j] = _sss_pool_bytes[j-1];
+            }
+            _sss_pool_offset[i] = gap_start;
+            _sss_pool_bytes[i] = bytes;
+            _sss_pool_count++;
+            return (uint8_t *)_sss_pool + gap_start;
+        }
+        if (i < _sss_pool_count) {
+            gap_start = _sss_pool_offset[i] + _sss_pool_bytes[i];
+        }
+    }
 
-        case SSS_SERIAL_7O1:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x100;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1);
-            break;
+    return NULL;
+}
 
-        case SSS_SERIAL_8O1:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x200;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_1);
-            break;
+// Take back a block. False if it isn't one of ours.
+static bool _sss_pool_give(void *block) {
+    uint32_t offset = (uint8_t *)block - (uint8_t *)_sss_pool;
+    int i;
 
-        case SSS_SERIAL_5O2:
-            _num_bits_to_send = 8;
-            _stop_bits = 0xC0;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_2);
-            break;
+    if ((uint8_t *)block < (uint8_t *)_sss_pool || offset >= sizeof(_sss_pool)) {
+        return false;
+    }
 
-        case SSS_SERIAL_6O2:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x180;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_2);
-            break;
+    for (i=0; i < _sss_pool_count; i++) {
+        if (_sss_pool_offset[i] == offset) {
+            _sss_pool_count--;
+            for (; i < _sss_pool_count; i++) {
+                _sss_pool_offset[i] = _sss_pool_offset[i+1];
+                _sss_pool_bytes[i] = _sss_pool_bytes[i+1];
+            }
+            return true;
+        }
+    }
 
-        case SSS_SERIAL_7O2:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x300;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_2);
-            break;
+    return false;
+}
 
-        case SSS_SERIAL_8O2:
-            _num_bits_to_send = 11;
-            _stop_bits = 0x600;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_2);
-           break;
-
-        case SSS_SERIAL_5M1:
-            _num_bits_to_send = 7;
-            _stop_bits = 0x40;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1);
-           break;
-
-        case SSS_SERIAL_6M1:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x80;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1);
-            break;
+// Borrow the biggest ring buffer we can get from the pool, up to so many
+// characters. If that much isn't free, try half as many, and so on.
+static sss_buffer_word_t *_sss_pool_ring(uint32_t chars, int flag_bits, uint32_t *mask) {
+    uint32_t ring = 1;
+    void *block;
 
-        case SSS_SERIAL_7M1:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x100;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1);
-            break;
+    while (ring * 2 <= chars) {
+        ring *= 2;
+    }
 
-        case SSS_SERIAL_8M1:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x200;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_1);
-            break;
+    for (; ring > 0; ring /= 2) {
+        block = _sss_pool_take(_SSS_RING_BYTES(ring, flag_bits));
+        if (block != NULL) {
+            *mask = ring - 1;
+            return (sss_buffer_word_t *)block;
+        }
+    }
 
-        case SSS_SERIAL_5M2:
-            _num_bits_to_send = 8;
-            _stop_bits = 0xC0;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_2);
-            break;
+    return NULL;
+}
+#endif
 
-        case SSS_SERIAL_6M2:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x180;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_2);
-            break;
 
-        case SSS_SERIAL_7M2:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x300;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_2);
-            break;
+///////////////////////////////////////////////////////////////////////
+//  Public Member Functions
+///////////////////////////////////////////////////////////////////////
 
-        case SSS_SERIAL_8M2:
-            _num_bits_to_send = 11;
-            _stop_bits = 0x600;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_2);
-           break;
-
-        case SSS_SERIAL_5S1:
-            _num_bits_to_send = 7;
-            _stop_bits = 0x40;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1);
-           break;
-
-        case SSS_SERIAL_6S1:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x80;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1);
-            break;
+SlowSoftSerial::SlowSoftSerial(uint8_t rxPin, uint8_t txPin, bool inverse) {
+    _rxPin = rxPin;
+    _txPin = txPin;
+    _inverse = inverse;
+    _instance_active = false;
+    _slot = -1;
+    _timer_mode = SSS_TIMER_DEDICATED;
+    _rx_mode = SSS_RX_SAMPLED;
+    _rx_majority = false;
+    _tx_burst_budget = 0;
+    _rx_burst_budget = 0;
+    _sampler = NULL;
+    _single_running = false;
+    _single_tx = false;
+    _single_rx = _SSS_SINGLE_RX_IDLE;
+    _tx_running = false;        // so flush() and available() make sense before begin()
+    _tx_write_index = 0;
+    _tx_read_index = 0;
+    _rx_write_index = 0;
+    _rx_read_index = 0;
+    _tx_buffer_want = SSS_TX_BUFFER_SIZE;
+    _rx_buffer_want = SSS_RX_BUFFER_SIZE;
+#ifdef SSS_BUFFER_POOL_SIZE
+    _tx_buffer = _sss_no_buffer;
+    _tx_buffer_mask = 0;
+    _rx_buffer = _sss_no_buffer;
+    _rx_buffer_mask = 0;
+#ifdef SSS_COMPACT_BUFFERS
+    _rx_flags = _sss_no_flags;
+#endif
+#else
+    _tx_buffer = _tx_buffer_builtin;
+    _tx_buffer_mask = SSS_TX_BUFFER_SIZE - 1;
+    _rx_buffer = _rx_buffer_builtin;
+    _rx_buffer_mask = SSS_RX_BUFFER_SIZE - 1;
+#ifdef SSS_COMPACT_BUFFERS
+    _rx_flags = _rx_flags_builtin;
+#endif
+#endif
+}
 
-        case SSS_SERIAL_7S1:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x100;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1);
-            break;
 
-        case SSS_SERIAL_8S1:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x200;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_1);
-            break;
+void SlowSoftSerial::setTimerMode(uint8_t mode) {
+    if (!_instance_active) {
+        _timer_mode = mode;
+    }
+}
 
-        case SSS_SERIAL_5S2:
-            _num_bits_to_send = 8;
-            _stop_bits = 0xC0;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_2);
-            break;
 
-        case SSS_SERIAL_6S2:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x180;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_2);
-            break;
+void SlowSoftSerial::setRxMode(uint8_t mode) {
+    if (!_instance_active) {
+        _rx_mode = mode;
+    }
+}
 
-        case SSS_SERIAL_7S2:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x300;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_2);
-            break;
 
-        case SSS_SERIAL_8S2:
-            _num_bits_to_send = 11;
-            _stop_bits = 0x600;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_2);
-            break;
+void SlowSoftSerial::setMajorityVote(bool enable) {
+    if (!_instance_active) {
+        _rx_majority = enable;
+    }
+}
 
-        case SSS_SERIAL_5N15:
-            _num_bits_to_send = 6;
-            _stop_bits = 0x60;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x10;
-            _fill_op_table(5,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
 
-        case SSS_SERIAL_6N15:
-            _num_bits_to_send = 7;
-            _stop_bits = 0xC0;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+void SlowSoftSerial::setTxBurst(float maxMicroseconds) {
+    if (!_instance_active) {
+        _tx_burst_budget = maxMicroseconds;
+    }
+}
 
-        case SSS_SERIAL_7N15:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x180;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
 
-        case SSS_SERIAL_8N15:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x300;
-            _parity_bit = 0;
-            _parity = SSS_SERIAL_PARITY_NONE;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+void SlowSoftSerial::setRxBurst(float maxMicroseconds) {
+    if (!_instance_active) {
+        _rx_burst_budget = maxMicroseconds;
+    }
+}
 
-        case SSS_SERIAL_5E15:
-            _num_bits_to_send = 7;
-            _stop_bits = 0xC0;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
 
-        case SSS_SERIAL_6E15:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x180;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+void SlowSoftSerial::setBufferSizes(uint32_t txChars, uint32_t rxChars) {
+    if (!_instance_active) {
+        _tx_buffer_want = txChars;
+        _rx_buffer_want = rxChars;
+    }
+}
 
-        case SSS_SERIAL_7E15:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x300;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
 
-        case SSS_SERIAL_8E15:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x600;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_EVEN;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+void SlowSoftSerial::addMemoryForRead(void *buffer, size_t size) {
+    uint32_t mask;
+    sss_buffer_word_t *ring;
 
-        case SSS_SERIAL_5O15:
-            _num_bits_to_send = 7;
-            _stop_bits = 0xC0;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+    if (!_instance_active && (ring = _sss_ring_memory(buffer, size, _SSS_RX_FLAG_BITS, &mask)) != NULL) {
+        _rx_buffer = ring;
+        _rx_buffer_mask = mask;
+#ifdef SSS_COMPACT_BUFFERS
+        _rx_flags = (uint8_t *)(ring + mask + 1);
+#endif
+    }
+}
 
-        case SSS_SERIAL_6O15:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x180;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
 
-        case SSS_SERIAL_7O15:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x300;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+void SlowSoftSerial::addMemoryForWrite(void *buffer, size_t size) {
+    uint32_t mask;
+    sss_buffer_word_t *ring;
 
-        case SSS_SERIAL_8O15:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x600;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_ODD;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+    if (!_instance_active && (ring = _sss_ring_memory(buffer, size, 0, &mask)) != NULL) {
+        _tx_buffer = ring;
+        _tx_buffer_mask = mask;
+    }
+}
 
-        case SSS_SERIAL_5M15:
-            _num_bits_to_send = 7;
-            _stop_bits = 0xC0;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
 
-        case SSS_SERIAL_6M15:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x180;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+void SlowSoftSerial::begin(double baudrate, uint16_t config, uint8_t oversample) {
+    _SSS_Format format;
+    int slot;
 
-        case SSS_SERIAL_7M15:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x300;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+    if (_instance_active) {
+        return;
+    }
 
-        case SSS_SERIAL_8M15:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x600;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_MARK;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+    _tx_timer.end();     // just in case begin is called out of sequence
 
-        case SSS_SERIAL_5S15:
-            _num_bits_to_send = 7;
-            _stop_bits = 0xC0;
-            _parity_bit = 0x20;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x1F;
-            _rx_shiftin_bit = 0x20;
-            _fill_op_table(6,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+    if (oversample < _SSS_MIN_OVERSAMPLE || oversample > SSS_MAX_OVERSAMPLE) {
+        return;
+    }
+    _rx_oversample = oversample;
 
-        case SSS_SERIAL_6S15:
-            _num_bits_to_send = 8;
-            _stop_bits = 0x180;
-            _parity_bit = 0x40;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x3F;
-            _rx_shiftin_bit = 0x40;
-            _fill_op_table(7,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-            break;
+    if (!_compute_format(baudrate, config, &format)) {
+        return;     // failure, unsupported baud rate or configuration
+    }
+    _apply_tx_format(&format);
+    _apply_rx_format(&format);
 
-        case SSS_SERIAL_7S15:
-            _num_bits_to_send = 9;
-            _stop_bits = 0x300;
-            _parity_bit = 0x80;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0x7F;
-            _rx_shiftin_bit = 0x80;
-            _fill_op_table(8,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
+    // Claim a slot, which gives us our own set of trampolines.
+    for (slot=0; slot < _SSS_MAX_INSTANCES; slot++) {
+        if (_sss_instances[slot] == NULL) {
             break;
+        }
+    }
+    if (slot >= _SSS_MAX_INSTANCES) {
+        return;     // failure, too many active instances
+    }
 
-        case SSS_SERIAL_8S15:
-            _num_bits_to_send = 10;
-            _stop_bits = 0x600;
-            _parity_bit = 0x100;
-            _parity = SSS_SERIAL_PARITY_SPACE;
-            _databits_mask = 0xFF;
-            _rx_shiftin_bit = 0x100;
-            _fill_op_table(9,SSS_SERIAL_STOP_BIT_1_5);
-            _tx_halfbaud = 1;
-            _tx_microseconds = _tx_microseconds/2.0;
-           break;
+    // We only hold the timers while we're actually sending or receiving,
+    // but there's no point in starting up if they can't be had at all.
+    if (!_timers_available()) {
+        return;     // failure, no timer available
+    }
 
-        default:
-            return;     // failure, unrecognized configuration word
+    if (!_borrow_buffers()) {
+        return;     // failure, buffer pool is used up
     }
 
+    _tx_invert = _inverse ? ~0ul : 0;
+    _single_tx_divider = oversample;    // transmit takes every so many ticks in single timer mode
+    _reconfig_pending = false;
+    _rx_reconfig_due = false;
+    _rx_active = false;
+    _poll_tx = false;
+    _poll_rx = false;
+
     // Initialize transmit
     // Writing both before and after eliminates a potential glitch.
     digitalWriteFast(_txPin, _SSS_STOP_LEVEL);
     pinMode(_txPin, OUTPUT);
     digitalWriteFast(_txPin, _SSS_STOP_LEVEL);
 
-    _tx_buffer_count = 0;
     _tx_write_index = 0;
     _tx_read_index = 0;
     _tx_bit_count = 0;
+    _tx_block_head = 0;
+    _tx_block_tail = 0;
+    _tx_block_active = false;
+    _tx_block_finishing = false;
     _rts_attached = false;
+    _rts_held = false;
     _cts_attached = false;
     _tx_enabled = true;
     _tx_running = false;
@@ -727,16 +460,23 @@ void SlowSoftSerial::begin(double baudrate, uint16_t config) {
     // Initialize receive
     pinMode(_rxPin, _inverse ? INPUT_PULLDOWN : INPUT_PULLUP);
 
-    _rx_buffer_count = 0;
     _rx_write_index = 0;
     _rx_read_index = 0;
-
-    // Keep track of our one and only active instance
+    _rx_edge_count = 0;
+    _rx_edge_overrun = false;
+    _rx_noisy = false;
+    _rx_corrected_bits = 0;
+
+    // Go live in our slot
+    _slot = slot;
+    _sss_instances[_slot] = this;
     _instance_active = true;
-    _active_count = 1;
-    instance_p = this;
 
-    attachInterrupt(digitalPinToInterrupt(_rxPin), _rx_start_trampoline, _inverse ? RISING : FALLING);
+    if (_rx_by_edges) {
+        attachInterrupt(digitalPinToInterrupt(_rxPin), _RX_EDGE_TRAMPOLINE, CHANGE);
+    } else {
+        attachInterrupt(digitalPinToInterrupt(_rxPin), _RX_START_TRAMPOLINE, _inverse ? RISING : FALLING);
+    }
 }
 
 
@@ -745,8 +485,12 @@ void SlowSoftSerial::end(bool releasePins) {
         return;
     }
 
-    _tx_timer.end();    // called first to avoid any conflict for variables
-    _rx_timer.end();
+    if (_sampler != NULL) {
+        _sampler->detach(*this);
+    }
+
+    _tx_timer_stop();   // called first to avoid any conflict for variables
+    _rx_timer_stop();
     detachInterrupt(digitalPinToInterrupt(_rxPin));
 
     if (releasePins == SSS_RELEASE_PINS) {
@@ -755,213 +499,871 @@ void SlowSoftSerial::end(bool releasePins) {
         if (_cts_attached) {
             pinMode(_ctsPin, INPUT);
         }
+        if (_rts_attached) {
+            pinMode(_rtsPin, INPUT);
+        }
     }
 
-    _tx_buffer_count = 0;
+    _tx_read_index = _tx_write_index;
     _tx_enabled = false;
     _tx_running = false;
     _cts_attached = false;
+    _rts_attached = false;
+    _rts_held = false;
 
-    // this instance is no longer active, so it's OK to activate another one
-    instance_p = NULL;
-    _active_count = 0;
+    // Any queued blocks are abandoned, without their callbacks
+    _tx_block_head = _tx_block_tail;
+    _tx_block_active = false;
+    _tx_block_finishing = false;
+
+    // So is any change of format that hasn't happened yet
+    _reconfig_pending = false;
+    _rx_reconfig_due = false;
+    _rx_active = false;
+
+    _return_buffers();
+
+    // this instance is no longer active, so give up our slot
+    _sss_instances[_slot] = NULL;
+    _slot = -1;
     _instance_active = false;
 }
 
 
 int SlowSoftSerial::available(void) {
-    return _rx_buffer_count;
+    return _rx_write_index - _rx_read_index;
 }
 
 
 int SlowSoftSerial::availableForWrite(void) {
-    return _SSS_TX_BUFFER_SIZE - _tx_buffer_count;
+    return (_tx_buffer_mask + 1) - (_tx_write_index - _tx_read_index);
 }
 
 
 int SlowSoftSerial::peek(void) {
     int chr;
 
-    if (_rx_buffer_count > 0) {
-        chr = _rx_buffer[_rx_read_index];
+    if (_rx_write_index != _rx_read_index) {
+        chr = _rx_word(_rx_read_index);
         // If we were going to check receive parity, this would be the place to do it.
         // However, the Arduino serial API has no notion of checking for errors.
-        return chr & _databits_mask;
+        return chr & (_SSS_RX_PARITY - 1);
     } else {
         return -1;      // nothing available to peek
     }
 }
 
 
+// With majority voting, tells whether the character that peek() or read()
+// would return next had any bits that were outvoted by noise.
+bool SlowSoftSerial::peekNoisy(void) {
+    return _rx_write_index != _rx_read_index
+        && (_rx_word(_rx_read_index) & _SSS_RX_NOISY);
+}
+
+
+uint32_t SlowSoftSerial::correctedBits(void) {
+    return _rx_corrected_bits;
+}
+
+
+void SlowSoftSerial::resetCorrectedBits(void) {
+    _rx_corrected_bits = 0;
+}
+
+
 int SlowSoftSerial::read(void) {
     int chr = peek();
 
     if (chr != -1) {
-        if (++_rx_read_index >= _SSS_RX_BUFFER_SIZE) {
-            _rx_read_index = 0;
-        }
+        consume(1);
+    }
+
+    return chr;
+}
+
+
+// Read whatever's available, up to size characters, without waiting.
+// The receive interrupt only ever adds characters, so we can take them
+// all out and then account for them at once.
+size_t SlowSoftSerial::read(uint8_t *buffer, size_t size) {
+    int count = available();
+    uint32_t index = _rx_read_index;
+    int i;
+
+    if ((size_t)count > size) {
+        count = size;
+    }
+
+    for (i=0; i < count; i++) {
+        *buffer++ = _rx_buffer[index++ & _rx_buffer_mask];
+    }
+
+    consume(count);
+    return count;
+}
+
+
+// The received characters that are next in line and contiguous in the
+// receive buffer, so they can be parsed where they are. There may be more
+// after these, once they're consumed, because the buffer wraps around.
+int SlowSoftSerial::peekSpan(const sss_buffer_word_t **words) {
+    int count = available();
+    uint32_t index = _rx_read_index & _rx_buffer_mask;
+    int contiguous = (_rx_buffer_mask + 1) - index;
+
+    *words = &_rx_buffer[index];
+    return count < contiguous ? count : contiguous;
+}
+
+
+// Throw away received characters, as if they'd been read.
+// The barrier makes sure we're done looking at them before the receive
+// interrupt is allowed to reuse their places.
+void SlowSoftSerial::consume(int count) {
+    int avail = available();
+
+    if (count > avail) {
+        count = avail;
+    }
+    if (count <= 0) {
+        return;
+    }
+
+    _SSS_BARRIER();
+    _rx_read_index += count;
 
+    // If RTS is holding off the sender, see if we've read enough to let it
+    // go again. The receive interrupt might be holding it off again at the
+    // same moment, so we check again with interrupts out.
+    if (_rts_attached && _rts_held && (uint32_t)available() <= _rts_low_water) {
         noInterrupts();
-        _rx_buffer_count--;
+        if (_rts_attached && _rts_held && (uint32_t)available() <= _rts_low_water) {
+            _rts_held = false;
+            digitalWriteFast(_rtsPin, _SSS_RTS_GO);
+        }
         interrupts();
     }
-
-    return chr;
 }
 
 
 // NOTE: flush() can take unbounded time to complete
 //       if CTS flow control is in use.
 void SlowSoftSerial::flush(void) {
-    while (_tx_buffer_count > 0 || _tx_running) {
+    while (_tx_write_index != _tx_read_index || _tx_running) {
         yield();
     }
 }
 
 
-size_t SlowSoftSerial::write(uint8_t chr) {
-    uint16_t data_as_sent;
-
-    // What should we do with characters that don't fit in the word size?
-    // Probably the least surprising and confusing thing is to send them
-    // anyway, truncated to the word size.
-    chr &= _databits_mask;
+// write(uint8_t) comes here too. Teensy's name notwithstanding, this sends
+// a word of whatever length the port is configured for.
+size_t SlowSoftSerial::write9bit(uint32_t word) {
 
-    data_as_sent = _add_parity(chr) | _stop_bits;
-    if (_inverse) {
-        data_as_sent ^= 0xFFFF;
+    if (!_instance_active) {
+        return 0;       // nowhere to send it
     }
 
     // Arduino Stream semantics require a blocking write()
-    while (_tx_buffer_count >= _SSS_TX_BUFFER_SIZE) {   // assumed atomic
+    while (availableForWrite() <= 0) {
         yield();
     }
 
     // add this character to the transmit buffer
-    // This is safe, because tx_write_index is not used by the ISR.
-    _tx_buffer[_tx_write_index++] = data_as_sent;
-    if (_tx_write_index >= _SSS_TX_BUFFER_SIZE) {
-        _tx_write_index = 0;
+    // The ISR won't look at it until _tx_commit() moves the write index.
+    _tx_buffer[_tx_write_index & _tx_buffer_mask] = _tx_to_buffer(word);
+
+    return _tx_commit(1);     // We "sent" the one character
+}
+
+
+// Print would call write(uint8_t) for each character, so we do the whole
+// buffer here. We frame as many characters as there's room for in the
+// transmit buffer, then hand them over all at once.
+size_t SlowSoftSerial::write(const uint8_t *buffer, size_t size) {
+    size_t remaining = size;
+    uint32_t index;
+    int room;
+    int i;
+
+    if (!_instance_active) {
+        return 0;
     }
 
-    noInterrupts();
-    _tx_buffer_count++;
-    interrupts();
+    while (remaining > 0) {
+        // Arduino Stream semantics require a blocking write()
+        while ((room = availableForWrite()) <= 0) {
+            yield();
+        }
+        if ((size_t)room > remaining) {
+            room = remaining;
+        }
 
-    // Start the baud rate interrupt if it isn't already running
-    // Note: we waste a baud before starting to transmit, in order
-    // to keep the transmit logic all in one place (the interrupt)
-    if (!_tx_running) {
-        if (_tx_timer.begin(_tx_trampoline, _tx_microseconds)) {
-            _tx_running = true;
-            _tx_baud_divider = _tx_halfbaud;    // only waste half a baud in 1.5 stop bits case
+        // The ISR won't look at these until _tx_commit() moves the write index.
+        index = _tx_write_index;
+        for (i=0; i < room; i++) {
+            _tx_buffer[index++ & _tx_buffer_mask] = _tx_to_buffer(*buffer++);
         }
+
+        remaining -= _tx_commit(room);
     }
 
-    return 1;     // We "sent" the one character
+    return size;
 }
 
 
-void SlowSoftSerial::attachCts(uint8_t pin_number) {
-    _ctsPin = pin_number;
-    _cts_attached = true;
-    pinMode(_ctsPin, _inverse ? INPUT_PULLUP : INPUT_PULLDOWN);
-}
+// Queue a block of characters to be sent straight from the caller's buffer,
+// in order with anything else written. The buffer has to stay put until the
+// callback (if any) is called, from interrupt context, when the last stop
+// bit of the block has gone out. We note where the transmit buffer's write
+// index is, and the interrupt sends the block when it gets there, so we
+// don't wait for anything. Returns false if the port isn't active, the block is empty, or too many
+// blocks are already queued.
+bool SlowSoftSerial::queueWrite(const uint8_t *buffer, size_t size, void (*callback)(void *), void *context) {
+    uint32_t tail = _tx_block_tail & (_SSS_TX_BLOCKS - 1);
+
+    if (!_instance_active || size == 0 || _tx_block_tail - _tx_block_head >= _SSS_TX_BLOCKS) {
+        return false;
+    }
 
+    _tx_block_buffer[tail] = buffer;
+    _tx_block_size[tail] = size;
+    _tx_block_callback[tail] = callback;
+    _tx_block_context[tail] = context;
+    _tx_block_at[tail] = _tx_write_index;
+    _SSS_BARRIER();
+    _tx_block_tail++;
 
-///////////////////////////////////////////////////////////////////////
-//  Transmit Private Functions
-///////////////////////////////////////////////////////////////////////
+    _tx_commit(0);      // can't fail; we checked that we're active
 
-// Determine the number of 1 bits in the character.
-// Return 1 if it's an odd number, 0 if it's an even number.
-static bool _parity_is_odd(uint8_t chr) {
-    chr = chr ^ (chr >> 4);     // isn't this clever? Not original with me.
-    chr = chr ^ (chr >> 2);
-    chr = chr ^ (chr >> 1);
-    return (chr & 0x01);
+    return true;
 }
 
 
-uint16_t SlowSoftSerial::_add_parity(uint8_t chr) {
-    uint16_t data_word = chr;
+// Queue a change of baud rate and configuration, to happen right after the
+// last character written so far. We work out the new format now, while
+// there's time, and the transmit interrupt just copies it in between
+// characters and restarts its timer at the new bit time. The receive side
+// may be in the middle of a character then, so it switches over when it's
+// done. Switching between sampled and edge receive would mean changing the
+// pin interrupt on the fly, so we don't allow that; neither the shared nor
+// the single timer can change its tick rate without upsetting someone else.
+bool SlowSoftSerial::queueReconfigure(double baudrate, uint16_t config) {
+    if (!_instance_active || _timer_mode != SSS_TIMER_DEDICATED || _sampler != NULL
+      || _reconfig_pending || _rx_reconfig_due) {
+        return false;
+    }
+    if (!_compute_format(baudrate, config, &_reconfig) || _reconfig.rx_by_edges != _rx_by_edges) {
+        return false;
+    }
 
-    switch (_parity) {
-        case SSS_SERIAL_PARITY_ODD:
-            if (!_parity_is_odd(chr)) {
-                data_word |= _parity_bit;
-            }
-            break;
+    _reconfig_at = _tx_write_index;
+    _reconfig_blocks = _tx_block_tail;
+    _SSS_BARRIER();
+    _reconfig_pending = true;
 
-        case SSS_SERIAL_PARITY_EVEN:
-            if (_parity_is_odd(chr)) {
-                data_word |= _parity_bit;
-            }
-            break;
+    // If transmit is idle, there's no need to wait for it.
+    noInterrupts();
+    if (!_tx_running && _reconfig_pending) {
+        _reconfigure();
+    }
+    interrupts();
 
-        case SSS_SERIAL_PARITY_MARK:
-            data_word |= _parity_bit;
-            break;
+    return true;
+}
 
-        case SSS_SERIAL_PARITY_SPACE:
-        default:
-            break;
+
+// Run the transmit and receive sides in polled mode, for every bit or
+// sample that's come due. Deadlines move ahead by exactly one period, the
+// same as the shared timer scheduler does it, so a late poll() costs us
+// some jitter but doesn't throw off the bit timing after it. The receive
+// deadline starts from the start bit interrupt, which is the only
+// interrupt we take.
+void SlowSoftSerial::poll(void) {
+    if (!_instance_active || _timer_mode != SSS_TIMER_POLLED) {
+        return;
+    }
+
+    while (_poll_rx && (int32_t)(ARM_DWT_CYCCNT - _poll_rx_deadline) >= 0) {
+        _poll_rx_deadline += _rx_next_cycles();
+        _rx_timer_handler();
     }
 
-    return data_word;
+    while (_poll_tx && (int32_t)(ARM_DWT_CYCCNT - _poll_tx_deadline) >= 0) {
+        _poll_tx_deadline += _tx_next_cycles;
+        _tx_handler();
+    }
 }
 
 
-// Handle the hardware transmit interrupt for 1.5-stop-bits case.
-//
-// In the common cases, the transmit interrupt comes once per baud.
-// In order to handle accurate timing for the case of 1.5 stop bits,
-// we run the transmit interrupt at double the baud rate.
-//
-// All processing is exactly the same except that an extra half baud
-// is inserted at the end of the stop bit. So, this function passes
-// interrupts through to the normal _tx_baud_handler() function.
-// After processing 1 stop bit in the 1.5 stop bit case,
-// _tx_baud_handler() sets the tx_baud_divider flag, which causes
-// the following passed-through interrupt(s) to be advanced by half a baud.
-void SlowSoftSerial::_tx_halfbaud_handler(void) {
-    if (_tx_baud_divider) {
-        _tx_baud_divider = 0;   // order is important here!
-        _tx_baud_handler();     // because this may overwrite _tx_baud_divider
-    } else {
-        _tx_baud_divider = 1;
+// The long-run transmit baud rate, from the ticks we actually count out.
+// In single timer mode, that's a whole number of receive timer ticks per
+// bit. In burst transmit, the timer counts out whole characters.
+double SlowSoftSerial::actualBaudRate(void) {
+    double ticks;
+
+    if (!_instance_active) {
+        return 0.0;
     }
-}
+
+    if (_timer_mode == SSS_TIMER_SINGLE) {
+        ticks = _single_tx_divider * floor(_rx_microseconds * (_SSS_TIMER_TICKS_PER_SECOND / 1000000.0) + 0.5);
+        return _SSS_TIMER_TICKS_PER_SECOND / ticks;
+    }
+
+    ticks = _tx_ticks + _tx_ticks_frac / 4294967296.0;
+    if (_tx_burst) {
+        ticks /= 1 + _num_bits_to_send + (_tx_halfbaud ? 0.5 : 0.0);
+    }
+    if (_timer_mode == SSS_TIMER_SHARED || _timer_mode == SSS_TIMER_POLLED) {
+        return _SSS_CYCLES_PER_SECOND / ticks;
+    }
+    return _SSS_TIMER_TICKS_PER_SECOND / ticks;
+}
+
+
+// The worst error in the length of any one bit, as a fraction of a bit.
+// Where we carry fractions of a tick, a bit is never off by a whole tick.
+// Where we don't, every bit is off by the same rounding. Burst transmit
+// times the bits of a character by the cycle counter, and the stop bit
+// makes up the difference to the timer's whole character.
+float SlowSoftSerial::maxBitError(void) {
+    double bit_ticks = _SSS_TIMER_TICKS_PER_SECOND / _baudrate;     // timer ticks
+    double bit_cycles = _SSS_CYCLES_PER_SECOND / _baudrate;         // CPU cycles
+    double sample_ticks = floor(_rx_microseconds * (_SSS_TIMER_TICKS_PER_SECOND / 1000000.0) + 0.5);
+    double frac = _tx_ticks_frac / 4294967296.0;
+    double tx_error;
+    double rx_error;
+
+    if (!_instance_active) {
+        return 0.0f;
+    }
+
+    if (_timer_mode == SSS_TIMER_SINGLE) {
+        tx_error = fabs(_single_tx_divider * sample_ticks - bit_ticks) / bit_ticks;
+    } else if (_tx_burst) {
+        tx_error = ((1 + _tx_bits) * fabs(_tx_bit_cycles - bit_cycles) + (frac != 0.0 ? 1.0 : 0.0)
+                    * _SSS_CYCLES_PER_SECOND / _SSS_TIMER_TICKS_PER_SECOND) / bit_cycles;
+    } else if (_timer_mode == SSS_TIMER_SHARED || _timer_mode == SSS_TIMER_POLLED) {
+        tx_error = (frac != 0.0 ? 1.0 : 0.0) / bit_cycles;
+    } else {
+        tx_error = (frac != 0.0 ? 1.0 : 0.0) / bit_ticks;
+    }
+
+    if (_rx_by_edges || _rx_burst) {
+        rx_error = fabs(_rx_bit_cycles - bit_cycles) / bit_cycles;
+    } else if (_timer_mode == SSS_TIMER_SHARED || _timer_mode == SSS_TIMER_POLLED) {
+        rx_error = (_rx_cycles_frac != 0 ? 1.0 : 0.0) / bit_cycles;
+    } else {
+        rx_error = fabs(_rx_oversample * sample_ticks - bit_ticks) / bit_ticks;
+    }
+
+    return tx_error > rx_error ? tx_error : rx_error;
+}
+
+
+// Start receive flow control on RTS. The receive interrupt holds off the
+// sender when the buffer fills to the high watermark, and consume() lets it
+// go when the buffer drains to the low watermark. There's a gap between
+// the two, so RTS doesn't flap on every character.
+void SlowSoftSerial::attachRts(uint8_t pin_number, int highWater, int lowWater) {
+    uint32_t size = _rx_buffer_mask + 1;
+
+    if (highWater <= 0 || (uint32_t)highWater > size) {
+        highWater = size - size/4;
+    }
+    if (lowWater <= 0) {
+        lowWater = size/4;
+    }
+    if (lowWater >= highWater) {
+        lowWater = highWater - 1;
+    }
+
+    _rtsPin = pin_number;
+    _rts_high_water = highWater;
+    _rts_low_water = lowWater;
+    _rts_held = false;
+
+    // Writing both before and after eliminates a potential glitch.
+    digitalWriteFast(_rtsPin, _SSS_RTS_GO);
+    pinMode(_rtsPin, OUTPUT);
+    digitalWriteFast(_rtsPin, _SSS_RTS_GO);
+    _rts_attached = true;
+}
+
+
+void SlowSoftSerial::attachCts(uint8_t pin_number) {
+    _ctsPin = pin_number;
+    _cts_attached = true;
+    pinMode(_ctsPin, _inverse ? INPUT_PULLUP : INPUT_PULLDOWN);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//  Configuration Private Functions
+///////////////////////////////////////////////////////////////////////
+
+// Work out everything that follows from the baud rate and configuration
+// word, without touching the port itself. Returns false if we can't do it.
+bool SlowSoftSerial::_compute_format(double baudrate, uint16_t config, _SSS_Format *f) {
+    int oversample = _rx_oversample;
+    int final_op;
+    int i;
+    double cycles_per_us = _SSS_CYCLES_PER_SECOND / 1000000.0;
+    double ticks;
+
+    if (baudrate < _SSS_MIN_BAUDRATE) {
+        return false;
+    }
+    f->baudrate = baudrate;
+    f->tx_microseconds = 1000000.0/baudrate;  // 1x baud rate
+    f->rx_microseconds = f->tx_microseconds/oversample;   // usually 4x baud rate
+
+    if (!_set_frame_format(config, f)) {
+        return false;   // unrecognized configuration word or too long
+    }
+
+    _fill_tx_framing(f);
+
+    f->rx_late_start = false;
+    if (_timer_mode == SSS_TIMER_SINGLE) {
+        // The one timer runs at the receive sample rate; transmit takes every
+        // fourth tick at 4x (six ticks for the bit and a half of 1.5 stop
+        // bits, which an odd oversampling factor can't do).
+        // Receive can't count on the timer being lined up with the start bit,
+        // and at 2x, seeing it late could put the only sample in each bit
+        // right on the next edge.
+        if (f->tx_halfbaud && (oversample & 1)) {
+            return false;   // can't time the half bit
+        }
+        if (oversample < _SSS_MIN_LATE_OVERSAMPLE) {
+            return false;
+        }
+        _sss_late_start_op_table(f->rx_op_table, f->rx_op_table);
+        f->rx_late_start = true;
+    } else if (_timer_mode == SSS_TIMER_SHARED || _timer_mode == SSS_TIMER_POLLED) {
+        _sss_enable_cycle_counter();
+        ticks = f->rx_microseconds * cycles_per_us;
+        f->rx_cycles = ticks;
+        f->rx_cycles_frac = (ticks - f->rx_cycles) * 4294967295.0;
+    }
+
+    // Majority voting needs to know how many votes there are in each bit,
+    // after any late start adjustment. With fewer than 3, there's no
+    // majority to be had: any disagreement is a tie, and the character
+    // gets thrown away anyway. So we won't pretend to do it.
+    f->rx_vote_samples = 0;
+    for (i=0; f->rx_op_table[i] != _SSS_OP_SHIFT && f->rx_op_table[i] != _SSS_OP_DECIDE; i++) {
+        if (f->rx_op_table[i] == _SSS_OP_COUNT0 || f->rx_op_table[i] == _SSS_OP_COUNT1) {
+            f->rx_vote_samples++;
+        }
+    }
+    if (_rx_majority && f->rx_vote_samples < 3) {
+        return false;
+    }
+
+    // Edge timestamp receive decodes each character at the same point where
+    // the FINAL op would have run. It needs a receive timer of its own, and
+    // the whole character has to fit easily within the range of the cycle
+    // counter, which rules out very slow baud rates. Otherwise, we quietly
+    // receive the usual way.
+    f->rx_by_edges = false;
+    if (_rx_mode == SSS_RX_EDGES && _timer_mode == SSS_TIMER_DEDICATED) {
+        for (final_op=0; f->rx_op_table[final_op] != _SSS_OP_FINAL; final_op++) {
+        }
+        if ((final_op + 1) * f->rx_microseconds * cycles_per_us < (double)0x40000000) {
+            _sss_enable_cycle_counter();
+            f->rx_bit_cycles = oversample * f->rx_microseconds * cycles_per_us + 0.5;
+            f->rx_final_cycles = (final_op + 1) * f->rx_microseconds * cycles_per_us + 0.5;
+            f->rx_by_edges = true;
+        }
+    }
+
+    // Burst receive takes in each character right in the start bit
+    // interrupt, sampling the middle of every bit by the cycle counter, up
+    // to the middle of the stop bit. No receive timer at all. That's only
+    // allowed if it fits in the latency budget; otherwise it's the op table.
+    // Like burst transmit, it's only for ports with timers of their own; in
+    // the other modes, the busy-wait would hold up other ports' bits.
+    f->rx_burst = false;
+    if (!f->rx_by_edges && _timer_mode == SSS_TIMER_DEDICATED
+      && (f->rx_bits + 1.5) * oversample * f->rx_microseconds <= _rx_burst_budget) {
+        _sss_enable_cycle_counter();
+        f->rx_bit_cycles = oversample * f->rx_microseconds * cycles_per_us + 0.5;
+        f->rx_burst = true;
+    }
+
+    // Burst transmit sends each character in one interrupt, busy-waiting
+    // through the start, data, and parity bits. That's only allowed if it
+    // fits in the latency budget. The stop bit(s) take care of themselves,
+    // so the transmit interrupt comes once per character.
+    f->tx_burst = false;
+    if (_timer_mode == SSS_TIMER_DEDICATED
+      && (1 + f->tx_bits) * f->tx_microseconds <= _tx_burst_budget) {
+        _sss_enable_cycle_counter();
+        f->tx_bit_cycles = f->tx_microseconds * cycles_per_us + 0.5;
+        f->tx_microseconds *= 1 + f->num_bits_to_send + (f->tx_halfbaud ? 0.5 : 0.0);
+        f->tx_burst = true;
+    }
+
+    // The transmit timer counts whole ticks: CPU cycles for the shared timer
+    // or polled mode, or the IntervalTimer's clock. We keep the fraction of a
+    // tick left over, and the transmit interrupt carries it from one bit (or
+    // burst character) to the next, so in the long run the baud rate comes
+    // out exact, even for 45.45 baud. In single timer mode, transmit goes by
+    // the receive timer's ticks, so there's no carrying.
+    if (_timer_mode == SSS_TIMER_SHARED || _timer_mode == SSS_TIMER_POLLED) {
+        ticks = f->tx_microseconds * cycles_per_us;
+    } else {
+        ticks = f->tx_microseconds * (_SSS_TIMER_TICKS_PER_SECOND / 1000000.0);
+    }
+    f->tx_ticks = ticks;
+    f->tx_ticks_frac = 0;
+    if (_timer_mode != SSS_TIMER_SINGLE) {
+        f->tx_ticks_frac = (ticks - f->tx_ticks) * 4294967295.0;
+    }
+
+    return true;
+}
+
+
+// Put a format into effect for transmit. The word size goes with transmit,
+// since that's where it matters most.
+void SlowSoftSerial::_apply_tx_format(const _SSS_Format *f) {
+    _baudrate = f->baudrate;
+    _tx_microseconds = f->tx_microseconds;
+    _tx_ticks = f->tx_ticks;
+    _tx_ticks_frac = f->tx_ticks_frac;
+    _tx_bit_cycles = f->tx_bit_cycles;
+    _tx_framing[0] = f->tx_framing[0];
+    _tx_framing[1] = f->tx_framing[1];
+    _databits_mask = f->databits_mask;
+    _num_bits_to_send = f->num_bits_to_send;
+    _tx_bits = f->tx_bits;
+    _tx_halfbaud = f->tx_halfbaud;
+    _tx_burst = f->tx_burst;
+}
+
+
+// Put a format into effect for receive
+void SlowSoftSerial::_apply_rx_format(const _SSS_Format *f) {
+    _rx_microseconds = f->rx_microseconds;
+    _rx_cycles = f->rx_cycles;
+    _rx_cycles_frac = f->rx_cycles_frac;
+    _rx_bit_cycles = f->rx_bit_cycles;
+    _rx_final_cycles = f->rx_final_cycles;
+    _parity_bit = f->parity_bit;
+    _rx_databits_mask = f->databits_mask;
+    _rx_shiftin_bit = f->rx_shiftin_bit;
+    _rx_bits = f->rx_bits;
+    _rx_vote_samples = f->rx_vote_samples;
+    _rx_by_edges = f->rx_by_edges;
+    _rx_burst = f->rx_burst;
+    _rx_late_start = f->rx_late_start;
+    memcpy(_rx_op_table, f->rx_op_table, sizeof(_rx_op_table));
+}
+
+
+// Put a format from queueReconfigure() into effect, with the transmitter
+// between characters. The receiver takes it now if it's between characters
+// too, or else when it gets there.
+// Called from the transmit interrupt, or with interrupts disabled.
+void SlowSoftSerial::_reconfigure(void) {
+    _apply_tx_format(&_reconfig);
+    if (_rx_active || _rx_edge_count != 0) {
+        _rx_reconfig_due = true;
+    } else {
+        _apply_rx_format(&_reconfig);
+    }
+    _reconfig_pending = false;
+}
+
+
+// Work out the frame format from the configuration word. This used to be
+// a big switch statement with a case for every supported combination, but
+// everything follows from the word length, parity, and stop bits, and
+// spelling out the longer (and shorter) word lengths would have made it
+// ten times as big.
+//
+// The data and parity bits go out (and come in) LS bit first, followed by
+// the stop bits. We count 1.5 stop bits as one for sending, and the
+// transmit interrupt adds the extra half bit. Returns false if the
+// configuration isn't one we support, or if the op table won't fit.
+bool SlowSoftSerial::_set_frame_format(uint16_t config, _SSS_Format *f) {
+    int databits;
+    int rxbits;
+    uint16_t stopbits = config & SSS_SERIAL_STOP_BIT_MASK;
+
+    switch (config & SSS_SERIAL_DATA_MASK) {
+        case SSS_SERIAL_DATA_4:
+            databits = 4;
+            break;
+
+        case 0:
+        case 0xE00:
+        case 0xF00:
+            return false;
+
+        default:
+            databits = ((config & SSS_SERIAL_DATA_MASK) >> 8) + 4;
+            break;
+    }
+    if (databits > SSS_MAX_DATA_BITS) {
+        return false;       // won't fit in the buffers
+    }
+
+    f->parity = config & SSS_SERIAL_PARITY_MASK;
+    if (f->parity < SSS_SERIAL_PARITY_EVEN || f->parity > SSS_SERIAL_PARITY_SPACE) {
+        return false;
+    }
+    if (stopbits != SSS_SERIAL_STOP_BIT_1 && stopbits != SSS_SERIAL_STOP_BIT_1_5
+      && stopbits != SSS_SERIAL_STOP_BIT_2) {
+        return false;
+    }
+    if (config & ~(SSS_SERIAL_DATA_MASK | SSS_SERIAL_STOP_BIT_MASK | SSS_SERIAL_PARITY_MASK)) {
+        return false;
+    }
+
+    rxbits = databits + (f->parity != SSS_SERIAL_PARITY_NONE);
+
+    f->parity_bit = (f->parity == SSS_SERIAL_PARITY_NONE) ? 0 : 1ul << databits;
+    f->databits_mask = (1ul << databits) - 1;
+    f->rx_shiftin_bit = 1ul << (rxbits - 1);
+    f->tx_bits = rxbits;
+    if (stopbits == SSS_SERIAL_STOP_BIT_1) {
+        f->num_bits_to_send = rxbits + 1;
+        f->stop_bits = 1ul << rxbits;
+    } else {
+        // 1.5 stop bits sends the second stop bit as a half bit
+        f->num_bits_to_send = (stopbits == SSS_SERIAL_STOP_BIT_2) ? rxbits + 2 : rxbits + 1;
+        f->stop_bits = 3ul << rxbits;
+    }
+
+    f->tx_halfbaud = (stopbits == SSS_SERIAL_STOP_BIT_1_5);
+
+    return _fill_op_table(f, rxbits, stopbits);
+}
+
+
+// With a buffer pool, borrow whichever buffers we haven't been given memory
+// for. False if the pool can't spare even one character's worth.
+bool SlowSoftSerial::_borrow_buffers(void) {
+#ifdef SSS_BUFFER_POOL_SIZE
+    sss_buffer_word_t *ring;
+
+    if (_tx_buffer == _sss_no_buffer) {
+        ring = _sss_pool_ring(_tx_buffer_want, 0, &_tx_buffer_mask);
+        if (ring == NULL) {
+            return false;
+        }
+        _tx_buffer = ring;
+    }
+
+    if (_rx_buffer == _sss_no_buffer) {
+        ring = _sss_pool_ring(_rx_buffer_want, _SSS_RX_FLAG_BITS, &_rx_buffer_mask);
+        if (ring == NULL) {
+            _return_buffers();
+            return false;
+        }
+        _rx_buffer = ring;
+#ifdef SSS_COMPACT_BUFFERS
+        _rx_flags = (uint8_t *)(ring + _rx_buffer_mask + 1);
+#endif
+    }
+#endif
+    return true;
+}
+
+
+// Give back anything we borrowed from the buffer pool.
+void SlowSoftSerial::_return_buffers(void) {
+#ifdef SSS_BUFFER_POOL_SIZE
+    if (_sss_pool_give(_tx_buffer)) {
+        _tx_buffer = _sss_no_buffer;
+        _tx_buffer_mask = 0;
+        _tx_read_index = _tx_write_index;
+    }
+
+    // Whatever wasn't read goes with the buffer
+    if (_sss_pool_give(_rx_buffer)) {
+        _rx_buffer = _sss_no_buffer;
+        _rx_buffer_mask = 0;
+        _rx_read_index = _rx_write_index;
+#ifdef SSS_COMPACT_BUFFERS
+        _rx_flags = _sss_no_flags;
+#endif
+    }
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//  Transmit Private Functions
+///////////////////////////////////////////////////////////////////////
+
+// Work out everything write() needs to frame a character, so it doesn't
+// have to think about parity or inversion for each one. The framing bits
+// (parity and stop bits) depend only on whether the character has an odd
+// or even number of 1 bits.
+void SlowSoftSerial::_fill_tx_framing(_SSS_Format *f) {
+    f->tx_framing[0] = f->stop_bits;    // for characters with even parity
+    f->tx_framing[1] = f->stop_bits;    // for characters with odd parity
+
+    switch (f->parity) {
+        case SSS_SERIAL_PARITY_ODD:
+            f->tx_framing[0] |= f->parity_bit;
+            break;
+
+        case SSS_SERIAL_PARITY_EVEN:
+            f->tx_framing[1] |= f->parity_bit;
+            break;
+
+        case SSS_SERIAL_PARITY_MARK:
+            f->tx_framing[0] |= f->parity_bit;
+            f->tx_framing[1] |= f->parity_bit;
+            break;
+
+        case SSS_SERIAL_PARITY_SPACE:
+        default:
+            break;
+    }
+}
+
+
+// Add the parity and stop bits to a character, ready to send.
+// What should we do with characters that don't fit in the word size?
+// Probably the least surprising and confusing thing is to send them
+// anyway, truncated to the word size.
+uint32_t SlowSoftSerial::_tx_frame(uint32_t word) {
+    uint16_t chr = word & _databits_mask;
+
+    return (chr | _tx_framing[_sss_word_parity_is_odd(chr)]) ^ _tx_invert;
+}
+
+
+// Normally characters are framed as they go into the transmit buffer, so
+// the interrupt has less to do. With compact buffers, there isn't room for
+// the framing bits, so the interrupt frames each character as it comes out.
+// Characters written after queueReconfigure() are framed the new way, even
+// though the old way is still in effect for the ones ahead of them.
+inline sss_buffer_word_t SlowSoftSerial::_tx_to_buffer(uint32_t word) {
+#ifdef SSS_COMPACT_BUFFERS
+    return word;
+#else
+    if (_reconfig_pending) {
+        uint16_t chr = word & _reconfig.databits_mask;
+        return (chr | _reconfig.tx_framing[_sss_word_parity_is_odd(chr)]) ^ _tx_invert;
+    }
+    return _tx_frame(word);
+#endif
+}
+
+
+inline uint32_t SlowSoftSerial::_tx_from_buffer(sss_buffer_word_t word) {
+#ifdef SSS_COMPACT_BUFFERS
+    return _tx_frame(word);
+#else
+    return word;
+#endif
+}
+
+
+// Hand over characters that write() has put in the transmit buffer.
+// Once the write index has moved, a running interrupt will find them before
+// it can decide to shut down, so there's nothing to lock.
+//
+// Start the baud rate interrupt if it isn't already running. That's the
+// only time we keep interrupts out, because starting the timer can touch
+// state we share with the receive side and with other ports.
+// If nothing is holding us up, we send the start bit right now, and the
+// first interrupt comes one bit time later to send the first data bit,
+// just as if an interrupt had sent the start bit. Otherwise, the first
+// interrupt has to get things going, and we waste a baud. That includes
+// single timer mode when the timer is already running for receive,
+// because the first interrupt could come any time in the next sample time.
+// In burst mode, sending the character means busy-waiting through all of
+// it, which we won't do with interrupts off. So we only claim the character
+// while they're off, and send it once they're back on. That's safe because
+// the first interrupt is a whole character time away, and the burst is
+// done once the first stop bit goes out.
+// Returns how many characters were handed over: all of them, or none if
+// the port isn't active (and there's no slot to start a timer for).
+int SlowSoftSerial::_tx_commit(int count) {
+    bool send_now;
+    bool burst_now = false;
+    uint32_t burst_word = 0;
+
+    if (!_instance_active) {
+        return 0;
+    }
+
+    _SSS_BARRIER();
+    _tx_write_index += count;
+
+    if (!_tx_running) {
+        noInterrupts();
+        send_now = _tx_enabled && !(_cts_attached && !CTS_ASSERTED)
+                && !(_timer_mode == SSS_TIMER_SINGLE && _single_running);
+        if (_tx_timer_start()) {
+            _tx_running = true;
+            if (send_now && _tx_burst) {
+                burst_word = _tx_take_char();
+                burst_now = true;
+            } else if (send_now) {
+                _tx_next_char();
+            }
+        }
+        interrupts();
+
+        if (burst_now) {
+            _tx_burst_char(burst_word);
+        }
+    }
+
+    return count;
+}
+
 
 // Handle the transmit interrupt
 // Interrupt occurs periodically while we're actively transmitting
 // or waiting for handshaking to allow transmitting.
 // For most cases we only need the interrupts that occur at an
 // integer number of bauds from the beginning of the start bit.
-// For cases with 1.5 stop bits, though, we need to take one final
-// interrupt that's halfway between those integer bauds.
-void SlowSoftSerial::_tx_baud_handler(void) {
-    uint16_t data_as_sent;
-
+// For cases with 1.5 stop bits, though, the stop bit lasts a bit and a
+// half, so we stretch the timer interval for just that one bit. The timer
+// has to be told an interval ahead, so we stretch it as we send the last
+// data (or parity) bit, and put it back as we send the stop bit.
+// Unless the bit time is a whole number of ticks, we also tell the timer
+// every interval, so it can carry the fraction of a tick.
+void SlowSoftSerial::_tx_handler(void) {
     if (_tx_bit_count > 0) {
         // We're in the middle of sending a character, keep sending it
         digitalWriteFast(_txPin, _tx_data_word & 0x01);
         _tx_data_word >>= 1;
+        if (_tx_ticks_frac != 0 || (_tx_halfbaud && _tx_bit_count <= 2)) {
+            _tx_timer_update(_tx_halfbaud && _tx_bit_count == 2);
+        }
         _tx_bit_count--;
         return;
     }
 
-    if (_tx_extra_half_stop) {
-        // We've sent the first 1 stop bit, now send a half-baud more
-        _tx_extra_half_stop = 0;
-        _tx_baud_divider = 1;    // this jumps timing by half a baud
-        return;
+    if (_tx_block_finishing) {
+        // The last character of a block is all the way out
+        _tx_block_finish();
+    }
+
+    if (_reconfig_pending && _tx_read_index == _reconfig_at
+      && _tx_block_head == _reconfig_blocks && !_tx_block_active) {
+        // Everything ahead of the change of format is all the way out.
+        // Restart the timer, so the next start bit gets the new bit time.
+        _reconfigure();
+        _tx_timer_start();
     }
 
-    if (_tx_buffer_count == 0) {
+    if (_tx_write_index == _tx_read_index && _tx_block_head == _tx_block_tail) {
         // Nothing more to transmit right now, shut it down
         _tx_running = false;
-        _tx_timer.end();
+        _tx_timer_stop();
         digitalWriteFast(_txPin, _SSS_STOP_LEVEL);  // just to be sure
         return;
     }
@@ -972,24 +1374,88 @@ void SlowSoftSerial::_tx_baud_handler(void) {
         return;
     }
 
-    // Get the next character and begin to send it
-    data_as_sent = _tx_buffer[_tx_read_index++];
-    if (_tx_read_index >= _SSS_TX_BUFFER_SIZE) {
-        _tx_read_index = 0;
+    if (_tx_ticks_frac != 0) {
+        _tx_timer_update(false);
+    }
+    _tx_next_char();
+}
+
+
+// Get the next character and begin to send it, starting with the start bit.
+// Called from the transmit interrupt, or from write() with interrupts disabled.
+void SlowSoftSerial::_tx_next_char(void) {
+    uint32_t data_as_sent = _tx_take_char();
+
+    if (_tx_burst) {
+        _tx_burst_char(data_as_sent);
+        return;
     }
-    _tx_buffer_count--;
     digitalWriteFast(_txPin, _SSS_START_LEVEL);
     _tx_data_word = data_as_sent;
     _tx_bit_count = _num_bits_to_send;
-    _tx_extra_half_stop = _tx_halfbaud;
 }
 
 
-void _tx_trampoline(void) {
-    if (instance_p->_tx_halfbaud) {
-        instance_p->_tx_halfbaud_handler();
+// Take the next character to send, from the queued block if one is due or
+// else from the transmit buffer, and return it framed and ready to go.
+uint32_t SlowSoftSerial::_tx_take_char(void) {
+    uint32_t data_as_sent;
+
+    if (!_tx_block_active && _tx_block_head != _tx_block_tail
+      && _tx_block_at[_tx_block_head & (_SSS_TX_BLOCKS - 1)] == _tx_read_index) {
+        // Time to send the next queued block, ahead of anything written after it
+        _tx_block_next = _tx_block_buffer[_tx_block_head & (_SSS_TX_BLOCKS - 1)];
+        _tx_block_remaining = _tx_block_size[_tx_block_head & (_SSS_TX_BLOCKS - 1)];
+        _tx_block_active = true;
+    }
+
+    if (_tx_block_active) {
+        data_as_sent = _tx_frame(*_tx_block_next++);
+        if (--_tx_block_remaining == 0) {
+            _tx_block_active = false;
+            _tx_block_finishing = true;
+        }
     } else {
-        instance_p->_tx_baud_handler();
+        data_as_sent = _tx_from_buffer(_tx_buffer[_tx_read_index & _tx_buffer_mask]);
+        _SSS_BARRIER();
+        _tx_read_index++;
+    }
+
+    return data_as_sent;
+}
+
+
+// Retire the block at the head of the queue and let the caller know.
+void SlowSoftSerial::_tx_block_finish(void) {
+    void (*callback)(void *) = _tx_block_callback[_tx_block_head & (_SSS_TX_BLOCKS - 1)];
+    void *context = _tx_block_context[_tx_block_head & (_SSS_TX_BLOCKS - 1)];
+
+    _tx_block_finishing = false;
+    _SSS_BARRIER();
+    _tx_block_head++;
+
+    if (callback != NULL) {
+        callback(context);
+    }
+}
+
+
+// Send a whole character in one go, timing the bit edges by busy-waiting
+// on the cycle counter. We stop after the first stop bit goes out; the rest
+// of the stop bit time passes before the next transmit interrupt. Each
+// edge is timed from the start bit, so errors don't add up.
+void SlowSoftSerial::_tx_burst_char(uint32_t data_as_sent) {
+    uint32_t start = ARM_DWT_CYCCNT;
+    uint32_t edge = 0;
+    int bit;
+
+    digitalWriteFast(_txPin, _SSS_START_LEVEL);
+    for (bit=0; bit <= _tx_bits; bit++) {
+        edge += _tx_bit_cycles;
+        while (ARM_DWT_CYCCNT - start < edge) {
+        }
+        digitalWriteFast(_txPin, data_as_sent & 0x01);
+        data_as_sent >>= 1;
     }
 }
 
@@ -1002,40 +1468,91 @@ void _tx_trampoline(void) {
 // This controls what happens on each RX timer event during a
 // single character of reception.
 // rxbits includes data bits and parity bits, if any.
-void SlowSoftSerial::_fill_op_table(int rxbits, int stopbits) {
+//
+// There are _rx_oversample timer events per bit. The last one in each bit
+// lands right on the boundary with the next bit, where we CLEAR or SHIFT.
+// We only sample in the middle half of each bit, so that more oversampling
+// doesn't mean sampling closer to the edges; samples outside the middle
+// half are NULL. With the usual 4x oversampling, that's all three samples
+// in between the boundaries, same as always. At 2x, it's just the one
+// sample right in the middle. The FINAL sample comes a quarter bit
+// (rounded down to a whole sample, so the middle of the stop bit at 2x)
+// before the end of the stop bit(s), or as close as we can get to that
+// for 1.5 stop bits.
+//
+// With majority voting, the data and parity bits use the COUNT and DECIDE
+// ops instead of VOTE and SHIFT. The start and stop bits are still checked
+// strictly, since they're what keep us in sync with the characters.
+// Returns false if the table would be too big (long words, lots of samples).
+bool SlowSoftSerial::_fill_op_table(_SSS_Format *f, int rxbits, int stopbits) {
+    int n = _rx_oversample;
+    int first = (n + 3) / 4;        // first sample in the middle half of a bit
+    int last = (3 * n) / 4;         // last sample in the middle half of a bit
+    int stop_halves;                // length of the stop bit(s) in half bits
+    int final;
     int i = 0;
     int bit;
+    int tick;
+
+    f->rx_bits = rxbits;
 
-    _rx_op_table[i++] = _SSS_OP_START;
-    _rx_op_table[i++] = _SSS_OP_START;
-    _rx_op_table[i++] = _SSS_OP_START;
-    _rx_op_table[i++] = _SSS_OP_CLEAR;
-    for (bit=0; bit < rxbits; bit++) {
-        _rx_op_table[i++] = _SSS_OP_VOTE0;
-        _rx_op_table[i++] = _SSS_OP_VOTE1;
-        _rx_op_table[i++] = _SSS_OP_VOTE1;
-        _rx_op_table[i++] = _SSS_OP_SHIFT;
-    }
-    _rx_op_table[i++] = _SSS_OP_STOP;
-    _rx_op_table[i++] = _SSS_OP_STOP;
     if (stopbits == SSS_SERIAL_STOP_BIT_1_5) {
-        _rx_op_table[i++] = _SSS_OP_STOP;
-        _rx_op_table[i++] = _SSS_OP_STOP;
+        stop_halves = 3;
     } else if (stopbits == SSS_SERIAL_STOP_BIT_2) {
-        _rx_op_table[i++] = _SSS_OP_STOP;
-        _rx_op_table[i++] = _SSS_OP_STOP;
-        _rx_op_table[i++] = _SSS_OP_STOP;
-        _rx_op_table[i++] = _SSS_OP_STOP;
+        stop_halves = 4;
+    } else {
+        stop_halves = 2;
+    }
+    final = (2 * stop_halves * n - n) / 4;
+
+    // Long words with lots of oversampling may not fit
+    if ((1 + rxbits) * n + final > _SSS_MAX_OPTABLE_SIZE) {
+        return false;
+    }
+
+    for (tick=1; tick < n; tick++) {
+        f->rx_op_table[i++] = (tick >= first && tick <= last) ? _SSS_OP_START : _SSS_OP_NULL;
     }
-    _rx_op_table[i++] = _SSS_OP_FINAL;
+    f->rx_op_table[i++] = _SSS_OP_CLEAR;
+
+    for (bit=0; bit < rxbits; bit++) {
+        for (tick=1; tick < n; tick++) {
+            if (tick == first) {
+                f->rx_op_table[i++] = _rx_majority ? _SSS_OP_COUNT0 : _SSS_OP_VOTE0;
+            } else if (tick > first && tick <= last) {
+                f->rx_op_table[i++] = _rx_majority ? _SSS_OP_COUNT1 : _SSS_OP_VOTE1;
+            } else {
+                f->rx_op_table[i++] = _SSS_OP_NULL;
+            }
+        }
+        f->rx_op_table[i++] = _rx_majority ? _SSS_OP_DECIDE : _SSS_OP_SHIFT;
+    }
+
+    for (tick=1; tick < final; tick++) {
+        f->rx_op_table[i++] = (tick >= first) ? _SSS_OP_STOP : _SSS_OP_NULL;
+    }
+    f->rx_op_table[i++] = _SSS_OP_FINAL;
+
+    // The rest is never reached, but the sampler compares whole tables
+    while (i < _SSS_MAX_OPTABLE_SIZE) {
+        f->rx_op_table[i++] = _SSS_OP_NULL;
+    }
+
+    return true;
 }
 
 
 void SlowSoftSerial::_rx_start_handler(void) {
 
-    if (_rx_timer.begin(_rx_timer_trampoline, _rx_microseconds)) {
+    if (_rx_burst) {
+        _rx_burst_char();
+        return;     // and the start bit interrupt stays attached
+    }
+
+    _rx_op = 0;     // start at the 0th operation in the table
+    if (_rx_timer_start()) {
+        _rx_active = true;
         detachInterrupt(digitalPinToInterrupt(_rxPin));
-        _rx_op = 0;     // start at the 0th operation in the table
     } else {
         // timer not available, but there isn't much we can do.
         // continue to try every time we see a start bit!
@@ -1043,8 +1560,105 @@ void SlowSoftSerial::_rx_start_handler(void) {
 }
 
 
-static void _rx_start_trampoline(void) {
-    instance_p->_rx_start_handler();
+// Receive a whole character in burst mode, busy-waiting on the cycle counter
+// from one bit's middle to the next. Each sample is timed from the start bit
+// interrupt, so errors don't add up. The start bit has to still be there in
+// its middle, and the stop bit in its middle, or it's not a character.
+// Edges within the character can leave the start bit interrupt pending, so
+// we may be called again right away; the stop level sends us packing.
+void SlowSoftSerial::_rx_burst_char(void) {
+    uint32_t start = ARM_DWT_CYCCNT;
+    uint32_t sample = _rx_bit_cycles / 2;
+    uint32_t data_word = 0;
+    int bit;
+
+    if (digitalRead(_rxPin) != _SSS_START_LEVEL) {
+        return;
+    }
+
+    while (ARM_DWT_CYCCNT - start < sample) {
+    }
+    if (digitalRead(_rxPin) != _SSS_START_LEVEL) {
+        return;     // must have been noise
+    }
+
+    for (bit=0; bit < _rx_bits; bit++) {
+        sample += _rx_bit_cycles;
+        while (ARM_DWT_CYCCNT - start < sample) {
+        }
+        data_word >>= 1;
+        if (digitalRead(_rxPin) ^ _inverse) {
+            data_word |= _rx_shiftin_bit;
+        }
+    }
+
+    sample += _rx_bit_cycles;
+    while (ARM_DWT_CYCCNT - start < sample) {
+    }
+    if (digitalRead(_rxPin) == _SSS_STOP_LEVEL) {
+        _rx_store(data_word);
+    }
+}
+
+
+// Put a received character into the receive buffer, if there's room.
+// We store the data bits, and the parity bit as a flag. If there's to be any
+// parity checking, it must occur as the characters are read out of the
+// buffer (and not in interrupt context). The data bits are masked here, by
+// the format the character came in with, since a queueReconfigure() may
+// have changed the word size by the time it's read.
+void SlowSoftSerial::_rx_store(uint32_t data_word) {
+    uint32_t index = _rx_write_index & _rx_buffer_mask;
+
+    if (_rx_write_index - _rx_read_index <= _rx_buffer_mask) {
+#ifdef SSS_COMPACT_BUFFERS
+        // Only the interrupt ever writes the flags, so this is safe even
+        // though the same byte has flags for characters being read.
+        int shift = (index & 3) * 2;
+        uint8_t flags = ((data_word & _parity_bit) ? 1 : 0) | ((data_word & _SSS_RX_NOISY) ? 2 : 0);
+        _rx_buffer[index] = data_word & _rx_databits_mask;
+        _rx_flags[index >> 2] = (_rx_flags[index >> 2] & ~(3 << shift)) | (flags << shift);
+#else
+        _rx_buffer[index] = (data_word & (_rx_databits_mask | _SSS_RX_NOISY))
+                          | ((data_word & _parity_bit) ? _SSS_RX_PARITY : 0);
+#endif
+        _SSS_BARRIER();
+        _rx_write_index++;
+    }
+
+    if (_rts_attached && _rx_write_index - _rx_read_index >= _rts_high_water) {
+        _rts_held = true;
+        digitalWriteFast(_rtsPin, _SSS_RTS_WAIT);   // hold off the sender
+    }
+}
+
+
+// Get a character out of the receive buffer just as _rx_store() got it,
+// with its parity bit and flags.
+uint32_t SlowSoftSerial::_rx_word(uint32_t index) {
+    index &= _rx_buffer_mask;
+#ifdef SSS_COMPACT_BUFFERS
+    uint8_t flags = _rx_flags[index >> 2] >> ((index & 3) * 2);
+
+    return _rx_buffer[index] | ((flags & 1) ? _SSS_RX_PARITY : 0) | ((flags & 2) ? _SSS_RX_NOISY : 0);
+#else
+    return _rx_buffer[index];
+#endif
+}
+
+
+// Stop the receive timer and go back to waiting for a start bit.
+void SlowSoftSerial::_rx_hunt(void) {
+    _rx_timer_stop();
+    _rx_active = false;
+    if (_rx_reconfig_due) {
+        _apply_rx_format(&_reconfig);
+        _rx_reconfig_due = false;
+    }
+    if (_sampler != NULL) {
+        return;     // the sampler is doing our receiving
+    }
+    attachInterrupt(digitalPinToInterrupt(_rxPin), _RX_START_TRAMPOLINE, _inverse ? RISING : FALLING);
 }
 
 
@@ -1064,8 +1678,7 @@ void SlowSoftSerial::_rx_timer_handler(void) {
             if (digitalRead(_rxPin) != _SSS_START_LEVEL) {
                 // stop the timer and go back to waiting for a start bit.
                 // must have been noise, or baud rate error, or something.
-                _rx_timer.end();
-                attachInterrupt(digitalPinToInterrupt(_rxPin), _rx_start_trampoline, _inverse ? RISING : FALLING);
+                _rx_hunt();
             }
             break;
 
@@ -1075,21 +1688,22 @@ void SlowSoftSerial::_rx_timer_handler(void) {
             // can't meaningfully sample the RX pin. We can just get set up
             // for receiving the data bits.
             _rx_data_word = 0;
+            _rx_noisy = false;
             break;
             
         case _SSS_OP_VOTE0:
             // We're ready to take the first sample of a data or parity bit.
-            _rx_bit_value = digitalRead(_rxPin);
+            // Inverted signaling inverts the data bits, too.
+            _rx_bit_value = digitalRead(_rxPin) ^ _inverse;
             break;
             
         case _SSS_OP_VOTE1:
             // We're still in the middle of a data or parity bit.
             // Just make sure it hasn't changed on us.
-            if (digitalRead(_rxPin) != _rx_bit_value) {
+            if ((digitalRead(_rxPin) ^ _inverse) != _rx_bit_value) {
                 // stop the timer and go back to waiting for a start bit.
                 // must have been noise, or baud rate error, or something.
-                _rx_timer.end();
-                attachInterrupt(digitalPinToInterrupt(_rxPin), _rx_start_trampoline, _inverse ? RISING : FALLING);
+                _rx_hunt();
             }
             break;
             
@@ -1111,8 +1725,7 @@ void SlowSoftSerial::_rx_timer_handler(void) {
             if (digitalRead(_rxPin) != _SSS_STOP_LEVEL) {
                 // stop the timer and go back to waiting for a start bit.
                 // must have been noise, or baud rate error, or something.
-                _rx_timer.end();
-                attachInterrupt(digitalPinToInterrupt(_rxPin), _rx_start_trampoline, _inverse ? RISING : FALLING);
+                _rx_hunt();
             }
             break;
             
@@ -1126,31 +1739,1000 @@ void SlowSoftSerial::_rx_timer_handler(void) {
             // for receiving the next character.
             if (digitalRead(_rxPin) == _SSS_STOP_LEVEL) {
                 // stop bit passed the last check, no timing errors on this character!
-                // We store the data and parity bits. If there's to be any parity checking,
-                // it must occur as the characters are read out of the buffer (and not in
-                // interrupt context).
-                if (_rx_buffer_count < _SSS_RX_BUFFER_SIZE) {
-                    _rx_buffer[_rx_write_index++] = _rx_data_word;
-                    if (_rx_write_index >= _SSS_RX_BUFFER_SIZE) {
-                        _rx_write_index = 0;
-                    }
-                    
-                    _rx_buffer_count++;
-                }
+                _rx_store(_rx_noisy ? (_rx_data_word | _SSS_RX_NOISY) : _rx_data_word);
             }
             // stop the timer and go back to waiting for a start bit.
-            _rx_timer.end();
-            attachInterrupt(digitalPinToInterrupt(_rxPin), _rx_start_trampoline, _inverse ? RISING : FALLING);
+            _rx_hunt();
             break;
-            
-        case _SSS_OP_NULL:
-        default:
+
+        case _SSS_OP_COUNT0:
+            // Majority voting: take the first sample of a data or parity bit.
+            // We count the 1 samples.
+            _rx_bit_value = digitalRead(_rxPin) ^ _inverse;
             break;
-    }
 
-}
+        case _SSS_OP_COUNT1:
+            // Majority voting: count another sample, without judging it yet.
+            _rx_bit_value += digitalRead(_rxPin) ^ _inverse;
+            break;
+
+        case _SSS_OP_DECIDE:
+            // Majority voting: we have reached the end of a data or parity bit.
+            // Shift in the bit that got the most votes. If the vote wasn't
+            // unanimous, we keep the character but mark it as noisy. A tie
+            // (only possible with an even number of samples) can't be decided,
+            // so we treat it like a disagreement without voting.
+            _rx_data_word >>= 1;
+            if (2 * _rx_bit_value > _rx_vote_samples) {
+                _rx_data_word |= _rx_shiftin_bit;
+            } else if (2 * _rx_bit_value == _rx_vote_samples) {
+                _rx_hunt();
+                break;
+            }
+            if (_rx_bit_value != 0 && _rx_bit_value != _rx_vote_samples) {
+                _rx_noisy = true;
+                _rx_corrected_bits++;
+            }
+            break;
+
+        case _SSS_OP_NULL:
+        default:
+            break;
+    }
+
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//  Edge Timestamp Receive Private Functions
+///////////////////////////////////////////////////////////////////////
+
+// In SSS_RX_EDGES mode, we don't sample the RX pin on a timer at all.
+// Instead, we take an interrupt on every change of the RX pin and record
+// the time of each edge with the cycle counter. When the end of the
+// character is due (where the FINAL op would be), a one-shot timer
+// interrupt decodes the whole character from the edge times. So, the
+// interrupt rate goes with the number of transitions, not the baud rate.
+//
+// Decoding works the same way as receive_char_from() in the autotest
+// analyzer: every edge has to land within a quarter bit of a bit boundary,
+// and the signal level alternates with each edge, so we know the value of
+// every bit. Interrupt latency only matters if it varies by more than a
+// quarter bit between edges of the same character.
+
+void SlowSoftSerial::_rx_edge_handler(void) {
+    uint32_t now = ARM_DWT_CYCCNT;
+
+    if (_rx_edge_count == 0) {
+        // We're idle, so this had better be the leading edge of a start bit.
+        if (digitalRead(_rxPin) != _SSS_START_LEVEL) {
+            return;
+        }
+        if (!_rx_decode_timer_start(now)) {
+            return;     // no timer, can't receive this character
+        }
+    }
+
+    if (_rx_edge_count < _SSS_MAX_EDGES) {
+        _rx_edges[_rx_edge_count++] = now;
+    } else {
+        _rx_edge_overrun = true;    // too noisy to be a character
+    }
+}
+
+
+// Set up the one-shot timer to decode the character that started at t0
+bool SlowSoftSerial::_rx_decode_timer_start(uint32_t t0) {
+    int32_t cycles = _rx_final_cycles - (ARM_DWT_CYCCNT - t0);
+
+    if (cycles < (int32_t)(_SSS_CYCLES_PER_SECOND / 1000000)) {
+        cycles = _SSS_CYCLES_PER_SECOND / 1000000;  // already due, or nearly so
+    }
+    return _rx_timer.begin(_RX_DECODE_TRAMPOLINE, (float)cycles * (1000000.0f / _SSS_CYCLES_PER_SECOND));
+}
+
+
+void SlowSoftSerial::_rx_decode_handler(void) {
+    uint32_t t0 = _rx_edges[0];
+    uint32_t offset;
+    uint32_t boundary;
+    uint32_t bit = 1;           // bit number of the next edge, counting the start bit as 0
+    uint32_t prev_bit = 0;      // bit number of the previous edge
+    uint32_t levels = 0;        // level of each bit, by bit number
+    uint8_t level = 0;          // level after the start edge is the start level
+    bool valid = !_rx_edge_overrun;
+    int edge;
+
+    _rx_timer.end();    // it's a one-shot
+
+    for (edge=1; edge < _rx_edge_count; edge++) {
+        offset = _rx_edges[edge] - t0;
+        if (offset >= _rx_final_cycles) {
+            break;      // this edge belongs to the next character
+        }
+
+        // Find the nearest bit boundary, and make sure the edge is close to it.
+        // The only boundaries allowed are at the ends of the start, data,
+        // and parity bits. No edges within the stop bit(s)!
+        bit = (offset + _rx_bit_cycles/2) / _rx_bit_cycles;
+        boundary = bit * _rx_bit_cycles;
+        if (bit <= prev_bit || bit > _rx_bits + 1u
+          || offset + _rx_bit_cycles/4 < boundary || offset > boundary + _rx_bit_cycles/4) {
+            valid = false;
+            break;
+        }
+
+        // All the bits since the previous edge were at the same level
+        if (level) {
+            levels |= (1ul << bit) - (1ul << prev_bit);
+        }
+        level ^= 1;
+        prev_bit = bit;
+    }
+
+    // The level after the last edge has to be the stop level. If that's all
+    // the edges, the pin should still be at the stop level, or we missed some.
+    if (!level || (edge >= _rx_edge_count && digitalRead(_rxPin) != _SSS_STOP_LEVEL)) {
+        valid = false;
+    }
 
+    if (valid) {
+        levels |= (1ul << (_rx_bits + 1)) - (1ul << prev_bit);
+        _rx_store((levels >> 1) & ((1ul << _rx_bits) - 1));
 
-void _rx_timer_trampoline(void) {
-    instance_p->_rx_timer_handler();
+        // Any more edges belong to the next character, which has already begun.
+        noInterrupts();
+        _rx_edge_count -= edge;
+        memmove(_rx_edges, &_rx_edges[edge], _rx_edge_count * sizeof(_rx_edges[0]));
+        if (_rx_edge_count > 0 && !_rx_decode_timer_start(_rx_edges[0])) {
+            _rx_edge_count = 0;
+        }
+        interrupts();
+    } else {
+        // Framing error, or noise. Throw away all the edges and look for
+        // another start bit on the next edge to the start level.
+        _rx_edge_count = 0;
+        _rx_edge_overrun = false;
+    }
+
+    if (_rx_edge_count == 0 && _rx_reconfig_due) {
+        _apply_rx_format(&_reconfig);
+        _rx_reconfig_due = false;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//  Timer Private Functions
+///////////////////////////////////////////////////////////////////////
+
+// In the default SSS_TIMER_DEDICATED mode, each port has two IntervalTimers
+// of its own, one for transmit and one for receive. In SSS_TIMER_SHARED mode,
+// all the ports share a single IntervalTimer, managed by the scheduler below.
+// In SSS_TIMER_SINGLE mode, each port has just one IntervalTimer of its own,
+// running at the receive sample rate, which drives transmit too.
+// In SSS_TIMER_POLLED mode, there's no timer; poll() watches the deadlines.
+
+bool SlowSoftSerial::_timers_available(void) {
+    switch (_timer_mode) {
+        case SSS_TIMER_SHARED:
+            return _sched_timer_available();
+
+        case SSS_TIMER_POLLED:
+            return true;
+
+        case SSS_TIMER_SINGLE:
+            if (!_rx_timer.begin(_sss_probe_callback, _rx_microseconds)) {
+                return false;
+            }
+            _rx_timer.end();
+            return true;
+
+        case SSS_TIMER_DEDICATED:
+        default:
+            if (!_tx_timer.begin(_sss_probe_callback, _tx_microseconds)) {
+                return false;
+            }
+            if (!_rx_timer.begin(_sss_probe_callback, _rx_microseconds)) {
+                _tx_timer.end();
+                return false;
+            }
+            _tx_timer.end();
+            _rx_timer.end();
+            return true;
+    }
+}
+
+
+// Called from write() with interrupts disabled, so that it can send the
+// start bit right after starting the timer.
+bool SlowSoftSerial::_tx_timer_start(void) {
+    switch (_timer_mode) {
+        case SSS_TIMER_SHARED:
+            _tx_phase = 0;
+            _tx_next_cycles = _tx_ticks;
+            return _sched_add(_SSS_EVENT_TX, ARM_DWT_CYCCNT + _tx_ticks);
+
+        case SSS_TIMER_POLLED:
+            _tx_phase = 0;
+            _tx_next_cycles = _tx_ticks;
+            _poll_tx_deadline = ARM_DWT_CYCCNT + _tx_ticks;
+            _SSS_BARRIER();
+            _poll_tx = true;
+            return true;
+
+        case SSS_TIMER_SINGLE:
+            _single_tx_ticks = _single_tx_divider;
+            _single_tx_next = _single_tx_divider;
+            _single_tx = true;
+            return _single_timer_start();
+
+        case SSS_TIMER_DEDICATED:
+        default:
+            _tx_phase = 0;
+            return _tx_timer.begin(_TX_TRAMPOLINE, _sss_ticks_to_us(_tx_ticks));
+    }
+}
+
+
+void SlowSoftSerial::_tx_timer_stop(void) {
+    switch (_timer_mode) {
+        case SSS_TIMER_SHARED:
+            _sched_remove(_SSS_EVENT_TX);
+            break;
+
+        case SSS_TIMER_POLLED:
+            _poll_tx = false;
+            break;
+
+        case SSS_TIMER_SINGLE:
+            noInterrupts();
+            _single_tx = false;
+            _single_timer_stop();
+            interrupts();
+            break;
+
+        case SSS_TIMER_DEDICATED:
+        default:
+            _tx_timer.end();
+            break;
+    }
+}
+
+
+// Set the length of the transmit interval after the one that's just
+// starting: normally one bit, or a bit and a half if stretch is set.
+// Each mode knows the following interval a tick ahead, just like the
+// IntervalTimer, which only takes the new period after the current one.
+// Whenever the carried fractions add up to a whole tick, that interval
+// gets one more tick.
+void SlowSoftSerial::_tx_timer_update(bool stretch) {
+    uint32_t ticks = _tx_ticks;
+
+    _tx_phase += _tx_ticks_frac;
+    if (_tx_phase < _tx_ticks_frac) {
+        ticks++;
+    }
+    if (stretch) {
+        ticks += _tx_ticks / 2;
+    }
+
+    switch (_timer_mode) {
+        case SSS_TIMER_SHARED:
+        case SSS_TIMER_POLLED:
+            _tx_next_cycles = ticks;
+            break;
+
+        case SSS_TIMER_SINGLE:
+            _single_tx_next = stretch ? _single_tx_divider + _single_tx_divider/2 : _single_tx_divider;
+            break;
+
+        case SSS_TIMER_DEDICATED:
+        default:
+            _tx_timer.update(_sss_ticks_to_us(ticks));
+            break;
+    }
+}
+
+
+// Called from the start bit interrupt
+bool SlowSoftSerial::_rx_timer_start(void) {
+    bool started;
+
+    switch (_timer_mode) {
+        case SSS_TIMER_SHARED:
+            noInterrupts();
+            _rx_phase = 0;
+            started = _sched_add(_SSS_EVENT_RX, ARM_DWT_CYCCNT + _rx_cycles);
+            interrupts();
+            return started;
+
+        case SSS_TIMER_POLLED:
+            _rx_phase = 0;
+            _poll_rx_deadline = ARM_DWT_CYCCNT + _rx_cycles;
+            _SSS_BARRIER();
+            _poll_rx = true;
+            return true;
+
+        case SSS_TIMER_SINGLE:
+            if (_single_running) {
+                // The timer is already running for transmit, so it isn't lined
+                // up with this start bit. Start sampling on the tick after next,
+                // which is up to one sample time late; the op table allows for it.
+                _single_rx = _SSS_SINGLE_RX_PENDING;
+                return true;
+            }
+            _single_rx = _SSS_SINGLE_RX_ACTIVE;
+            return _single_timer_start();
+
+        case SSS_TIMER_DEDICATED:
+        default:
+            return _rx_timer.begin(_RX_TIMER_TRAMPOLINE, _rx_microseconds);
+    }
+}
+
+
+void SlowSoftSerial::_rx_timer_stop(void) {
+    switch (_timer_mode) {
+        case SSS_TIMER_SHARED:
+            _sched_remove(_SSS_EVENT_RX);
+            break;
+
+        case SSS_TIMER_POLLED:
+            _poll_rx = false;
+            break;
+
+        case SSS_TIMER_SINGLE:
+            noInterrupts();
+            _single_rx = _SSS_SINGLE_RX_IDLE;
+            _single_timer_stop();
+            interrupts();
+            break;
+
+        case SSS_TIMER_DEDICATED:
+        default:
+            _rx_timer.end();
+            break;
+    }
+}
+
+
+// The next receive sample interval in CPU cycles (shared timer or polled),
+// carrying the fraction of a cycle just like transmit does.
+uint32_t SlowSoftSerial::_rx_next_cycles(void) {
+    _rx_phase += _rx_cycles_frac;
+    return _rx_cycles + (_rx_phase < _rx_cycles_frac ? 1 : 0);
+}
+
+
+// Start the one timer in single timer mode, unless it's already running.
+// Called with interrupts disabled (or from an interrupt).
+bool SlowSoftSerial::_single_timer_start(void) {
+    if (_single_running) {
+        return true;
+    }
+    if (!_rx_timer.begin(_SINGLE_TRAMPOLINE, _rx_microseconds)) {
+        _single_tx = false;
+        _single_rx = _SSS_SINGLE_RX_IDLE;
+        return false;
+    }
+    _single_running = true;
+    return true;
+}
+
+
+// Stop the one timer in single timer mode, if neither side needs it.
+// Called with interrupts disabled (or from an interrupt).
+void SlowSoftSerial::_single_timer_stop(void) {
+    if (_single_running && !_single_tx && _single_rx == _SSS_SINGLE_RX_IDLE) {
+        _rx_timer.end();
+        _single_running = false;
+    }
+}
+
+
+// Handle the one timer interrupt in single timer mode.
+// Receive runs on every tick, transmit on every 4th tick (6th at the end
+// of the stop bit for 1.5 stop bits).
+// Either one may stop the timer if the other one is idle.
+void SlowSoftSerial::_single_handler(void) {
+    if (_single_rx == _SSS_SINGLE_RX_ACTIVE) {
+        _rx_timer_handler();
+    } else if (_single_rx == _SSS_SINGLE_RX_PENDING) {
+        _single_rx = _SSS_SINGLE_RX_ACTIVE;     // sampling starts next tick
+    }
+
+    if (_single_tx && --_single_tx_ticks == 0) {
+        _single_tx_ticks = _single_tx_next;
+        _tx_handler();
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//  Shared Timer Scheduler
+///////////////////////////////////////////////////////////////////////
+
+// In SSS_TIMER_SHARED mode, every active transmitter and receiver has an
+// entry in a min-heap, keyed by the CPU cycle count when its next event
+// (bit or sample) is due. The one shared IntervalTimer is started as a
+// "one-shot" for the earliest deadline. When it fires, we dispatch every
+// event that's due, move each one's deadline ahead by its period, and
+// restart the timer for whatever deadline is now the earliest.
+//
+// Deadlines advance by exactly one period each time, so timing errors due
+// to interrupt latency don't accumulate; we only add jitter. The worst
+// dispatch lateness is recorded, so you can tell when too many ports are
+// running too fast for one timer.
+
+#define _SSS_SCHED_SIZE (2 * _SSS_MAX_INSTANCES)    // one TX and one RX per port
+
+// If the next deadline is closer than this, it's not worth restarting the
+// timer; we just wait for it.
+#define _SSS_SCHED_MIN_CYCLES (_SSS_CYCLES_PER_SECOND / 1000000)
+
+struct _sss_sched_entry_t {
+    SlowSoftSerial *port;
+    uint8_t event;          // _SSS_EVENT_TX or _SSS_EVENT_RX
+    uint32_t deadline;      // CPU cycle count when the event is due
+};
+
+static _sss_sched_entry_t _sched_heap[_SSS_SCHED_SIZE];
+static int _sched_count = 0;
+static bool _sched_dispatching = false;
+static uint32_t _sched_max_lateness = 0;    // in CPU cycles
+static IntervalTimer _sched_timer;
+
+
+// Deadlines wrap around along with the cycle counter, so compare by difference.
+static inline bool _sched_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+
+static void _sched_sift_up(int i) {
+    _sss_sched_entry_t entry = _sched_heap[i];
+    int parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!_sched_before(entry.deadline, _sched_heap[parent].deadline)) {
+            break;
+        }
+        _sched_heap[i] = _sched_heap[parent];
+        i = parent;
+    }
+    _sched_heap[i] = entry;
+}
+
+
+static void _sched_sift_down(int i) {
+    _sss_sched_entry_t entry = _sched_heap[i];
+    int child;
+
+    while ((child = 2*i + 1) < _sched_count) {
+        if (child+1 < _sched_count && _sched_before(_sched_heap[child+1].deadline, _sched_heap[child].deadline)) {
+            child++;
+        }
+        if (!_sched_before(_sched_heap[child].deadline, entry.deadline)) {
+            break;
+        }
+        _sched_heap[i] = _sched_heap[child];
+        i = child;
+    }
+    _sched_heap[i] = entry;
+}
+
+
+// Start the shared timer as a one-shot for the earliest deadline.
+// (Calling begin() on a running IntervalTimer restarts it from zero.)
+static bool _sched_arm(void) {
+    int32_t cycles = _sched_heap[0].deadline - ARM_DWT_CYCCNT;
+
+    if (cycles < (int32_t)_SSS_SCHED_MIN_CYCLES) {
+        cycles = _SSS_SCHED_MIN_CYCLES;
+    }
+    return _sched_timer.begin(SlowSoftSerial::_sched_dispatch, (float)cycles * (1000000.0f / _SSS_CYCLES_PER_SECOND));
+}
+
+
+bool SlowSoftSerial::_sched_timer_available(void) {
+    if (_sched_count > 0) {
+        return true;        // we've already got it
+    }
+    if (!_sched_timer.begin(_sss_probe_callback, 1000.0f)) {
+        return false;
+    }
+    _sched_timer.end();
+    return true;
+}
+
+
+// Called with interrupts disabled.
+bool SlowSoftSerial::_sched_add(uint8_t event, uint32_t deadline) {
+    int i;
+
+    if (_sched_count >= _SSS_SCHED_SIZE) {
+        return false;       // can't happen; there's room for every port
+    }
+
+    i = _sched_count++;
+    _sched_heap[i].port = this;
+    _sched_heap[i].event = event;
+    _sched_heap[i].deadline = deadline;
+    _sched_sift_up(i);
+
+    // If this is now the earliest deadline, the timer has to be restarted.
+    // Not while dispatching, though; the dispatcher will take care of it.
+    if (!_sched_dispatching && _sched_heap[0].port == this && _sched_heap[0].event == event) {
+        if (!_sched_arm()) {
+            _sched_count = 0;   // no timer, so nothing can be running
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void SlowSoftSerial::_sched_remove(uint8_t event) {
+    int i;
+
+    noInterrupts();
+    for (i=0; i < _sched_count; i++) {
+        if (_sched_heap[i].port == this && _sched_heap[i].event == event) {
+            _sched_heap[i] = _sched_heap[--_sched_count];
+            if (i < _sched_count) {
+                _sched_sift_down(i);
+                _sched_sift_up(i);
+            }
+            break;
+        }
+    }
+
+    // If we just removed the earliest deadline, the timer will fire early.
+    // That's harmless; the dispatcher will find nothing due and restart it.
+    if (_sched_count == 0 && !_sched_dispatching) {
+        _sched_timer.end();
+    }
+    interrupts();
+}
+
+
+void SlowSoftSerial::_sched_dispatch(void) {
+    _sss_sched_entry_t *next = &_sched_heap[0];
+    SlowSoftSerial *port;
+    uint32_t now;
+    int32_t early;
+
+    _sched_dispatching = true;
+
+    while (_sched_count > 0) {
+        now = ARM_DWT_CYCCNT;
+        early = next->deadline - now;
+        if (early > (int32_t)_SSS_SCHED_MIN_CYCLES) {
+            break;          // nothing else due yet
+        }
+        while (early > 0) {
+            early = next->deadline - ARM_DWT_CYCCNT;    // almost due; wait for it
+        }
+        if ((uint32_t)-early > _sched_max_lateness) {
+            _sched_max_lateness = -early;
+        }
+
+        // Schedule the following event for this port before handling this one,
+        // because the handler may decide to remove it.
+        port = next->port;
+        if (next->event == _SSS_EVENT_TX) {
+            next->deadline += port->_tx_next_cycles;
+            _sched_sift_down(0);
+            port->_tx_handler();
+        } else {
+            next->deadline += port->_rx_next_cycles();
+            _sched_sift_down(0);
+            port->_rx_timer_handler();
+        }
+    }
+
+    if (_sched_count > 0) {
+        _sched_arm();
+    } else {
+        _sched_timer.end();
+    }
+    _sched_dispatching = false;
+}
+
+
+float SlowSoftSerial::sharedTimerLateness(void) {
+    return _sched_max_lateness * (1000000.0f / _SSS_CYCLES_PER_SECOND);
+}
+
+
+void SlowSoftSerial::resetSharedTimerLateness(void) {
+    _sched_max_lateness = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//  Port-wide Receive Sampler
+///////////////////////////////////////////////////////////////////////
+
+// A SlowSoftSerialSampler takes over the receive side of any number of ports
+// that are all running at the same baud rate and configuration. Instead of a
+// start bit interrupt and a sample timer for each port, it runs one timer at
+// the ports' sample rate, reads each GPIO port register just once per tick,
+// and steps the receive state machine for all the ports from that snapshot.
+//
+// The state machine is the same one the ports use, except that a port
+// that's waiting for a start bit just watches for the falling edge (rising,
+// if inverted) in the snapshots. So, the start bit is seen up to one sample
+// time late, and all the samples are up to that much later. The last sample
+// in each bit (including the start and stop bits) could then land right on
+// the next edge, so we adjust the op table to leave them out. (See
+// _sss_late_start_op_table() above.)
+//
+// Each port is one bit in a GPIO register, so the ports sharing a register
+// (a bank) are handled together, 32 bits at a time. Finding start edges
+// takes a few mask operations per bank. Once a port has its start bit, its
+// place in the op table depends only on the tick it started, so all the
+// ports in a bank that started on the same tick form a group, and each op
+// is done once per group, with masks, instead of once per port. A port
+// that fails a check (a false start, a disputed sample, or a framing error)
+// just drops out of its group. The received bits are kept as one mask per
+// bit position, and only sorted out into words for each port at the end
+// of the character.
+
+static SlowSoftSerialSampler *_sss_samplers[_SSS_MAX_SAMPLERS];
+
+template <int N> static void _sampler_trampoline(void) {
+    _sss_samplers[N]->_timer_handler();
+}
+
+static const _sss_callback_t _sss_sampler_trampolines[_SSS_MAX_SAMPLERS] = {
+    _sampler_trampoline<0>, _sampler_trampoline<1>,
+};
+
+static_assert(_SSS_MAX_SAMPLERS == 2, "add or remove _sampler_trampoline<> above to match _SSS_MAX_SAMPLERS");
+
+
+// Find the whole GPIO input register that includes a pin, and the pin's bit.
+static volatile uint32_t *_sss_gpio_input_register(uint8_t pin, uint32_t *mask) {
+#if defined(__IMXRT1062__)
+    *mask = digitalPinToBitMask(pin);
+    return (volatile uint32_t *)portInputRegister(pin);
+#else
+    // On Teensy 3.x, portInputRegister() gives us the bit-band alias for just
+    // the one pin. Work backwards from that to the register and bit number.
+    uint32_t offset = (uintptr_t)portInputRegister(pin) - 0x42000000;
+
+    *mask = 1 << ((offset >> 2) & 31);
+    return (volatile uint32_t *)(uintptr_t)(0x40000000 + ((offset >> 5) & ~3));
+#endif
+}
+
+
+SlowSoftSerialSampler::SlowSoftSerialSampler() {
+    _lane_count = 0;
+    _bank_count = 0;
+    _group_count = 0;
+    _slot = -1;
+}
+
+
+bool SlowSoftSerialSampler::attach(SlowSoftSerial &port) {
+    uint8_t op_table[_SSS_MAX_OPTABLE_SIZE];
+    volatile uint32_t *reg;
+    uint32_t mask;
+    int slot;
+    int lane;
+    int bank;
+
+    if (!port._instance_active || port._sampler != NULL || port._rx_by_edges || port._rx_burst
+      || port._rx_majority || port._rx_oversample < _SSS_MIN_LATE_OVERSAMPLE
+      || _lane_count >= _SSS_SAMPLER_MAX_PORTS) {
+        return false;
+    }
+
+    // Each port needs a bit of its own in the snapshots
+    reg = _sss_gpio_input_register(port._rxPin, &mask);
+    for (lane=0; lane < _lane_count; lane++) {
+        if (_bank_reg[_lane_bank[lane]] == reg && _lane_mask[lane] == mask) {
+            return false;
+        }
+    }
+
+    // A port in single timer mode has already allowed for a late start.
+    if (port._rx_late_start) {
+        memcpy(op_table, port._rx_op_table, sizeof(op_table));
+    } else {
+        _sss_late_start_op_table(op_table, port._rx_op_table);
+    }
+    if (_lane_count > 0) {
+        // All the ports have to be receiving exactly the same way
+        if (port._rx_microseconds != _rx_microseconds
+          || port._rx_shiftin_bit != _rx_shiftin_bit
+          || memcmp(op_table, _rx_op_table, sizeof(_rx_op_table)) != 0) {
+            return false;
+        }
+    } else {
+        // First port; claim a slot (for a trampoline) and start the timer
+        for (slot=0; slot < _SSS_MAX_SAMPLERS; slot++) {
+            if (_sss_samplers[slot] == NULL) {
+                break;
+            }
+        }
+        if (slot >= _SSS_MAX_SAMPLERS) {
+            return false;
+        }
+
+        _rx_microseconds = port._rx_microseconds;
+        _rx_shiftin_bit = port._rx_shiftin_bit;
+        memcpy(_rx_op_table, op_table, sizeof(_rx_op_table));
+
+        _slot = slot;
+        _sss_samplers[_slot] = this;
+        if (!_timer.begin(_sss_sampler_trampolines[_slot], _rx_microseconds)) {
+            _sss_samplers[_slot] = NULL;
+            _slot = -1;
+            return false;
+        }
+    }
+
+    // Take the receive side away from the port. Once _sampler is set,
+    // the port won't go back to waiting for a start bit on its own.
+    port._sampler = this;
+    detachInterrupt(digitalPinToInterrupt(port._rxPin));
+    port._rx_timer_stop();
+
+    noInterrupts();
+    lane = _lane_count;
+    bank = _find_bank(reg);
+    _lane_port[lane] = &port;
+    _lane_mask[lane] = mask;
+    _lane_bank[lane] = bank;
+    _bank_lanes[bank] |= mask;
+    if (port._inverse) {
+        _bank_inverse[bank] |= mask;
+    }
+    _bank_hunting[bank] |= mask;
+    _bank_prev[bank] &= ~mask;  // so a port that's idle now doesn't look like a start bit
+    _lane_count++;
+    interrupts();
+
+    return true;
+}
+
+
+void SlowSoftSerialSampler::detach(SlowSoftSerial &port) {
+    uint32_t mask;
+    int lane;
+    int last;
+    int bank;
+    int group;
+
+    if (port._sampler != this) {
+        return;
+    }
+
+    noInterrupts();
+    for (lane=0; lane < _lane_count; lane++) {
+        if (_lane_port[lane] == &port) {
+            break;
+        }
+    }
+    bank = _lane_bank[lane];
+    mask = _lane_mask[lane];
+
+    // Take the port's bit out of its bank and out of any group it's in
+    for (group=_group_count - 1; group >= 0; group--) {
+        if (_group_bank[group] == bank) {
+            _group_mask[group] &= ~mask;
+            if (_group_mask[group] == 0) {
+                _drop_group(group);
+            }
+        }
+    }
+    _bank_lanes[bank] &= ~mask;
+    _bank_inverse[bank] &= ~mask;
+    _bank_hunting[bank] &= ~mask;
+    _bank_prev[bank] &= ~mask;
+
+    // Keep the lanes packed by moving the last one into the hole
+    last = --_lane_count;
+    _lane_port[lane] = _lane_port[last];
+    _lane_mask[lane] = _lane_mask[last];
+    _lane_bank[lane] = _lane_bank[last];
+
+    if (_bank_lanes[bank] == 0) {
+        _drop_bank(bank);
+    }
+    interrupts();
+
+    // Give the receive side back to the port
+    port._sampler = NULL;
+    port._rx_hunt();
+
+    if (_lane_count == 0) {
+        _timer.end();
+        _sss_samplers[_slot] = NULL;
+        _slot = -1;
+    }
+}
+
+
+void SlowSoftSerialSampler::end(void) {
+    while (_lane_count > 0) {
+        detach(*_lane_port[0]);
+    }
+}
+
+
+// Get the bank (index into the table of distinct GPIO registers) for a register
+int SlowSoftSerialSampler::_find_bank(volatile uint32_t *reg) {
+    int bank;
+
+    for (bank=0; bank < _bank_count; bank++) {
+        if (_bank_reg[bank] == reg) {
+            return bank;
+        }
+    }
+    _bank_reg[_bank_count] = reg;
+    _bank_lanes[_bank_count] = 0;
+    _bank_inverse[_bank_count] = 0;
+    _bank_hunting[_bank_count] = 0;
+    _bank_prev[_bank_count] = 0;
+    return _bank_count++;
+}
+
+
+// After the last lane in a bank goes away, keep the banks packed by moving
+// the last one into the hole.
+void SlowSoftSerialSampler::_drop_bank(int bank) {
+    int last = --_bank_count;
+    int i;
+
+    _bank_reg[bank] = _bank_reg[last];
+    _bank_lanes[bank] = _bank_lanes[last];
+    _bank_inverse[bank] = _bank_inverse[last];
+    _bank_hunting[bank] = _bank_hunting[last];
+    _bank_prev[bank] = _bank_prev[last];
+
+    for (i=0; i < _lane_count; i++) {
+        if (_lane_bank[i] == last) {
+            _lane_bank[i] = bank;
+        }
+    }
+    for (i=0; i < _group_count; i++) {
+        if (_group_bank[i] == last) {
+            _group_bank[i] = bank;
+        }
+    }
+}
+
+
+// When a group has no ports left in it, keep the groups packed by moving
+// the last one into the hole.
+void SlowSoftSerialSampler::_drop_group(int group) {
+    int last = --_group_count;
+
+    if (group == last) {
+        return;
+    }
+    _group_bank[group] = _group_bank[last];
+    _group_op[group] = _group_op[last];
+    _group_shifts[group] = _group_shifts[last];
+    _group_mask[group] = _group_mask[last];
+    _group_bit[group] = _group_bit[last];
+    memcpy(_group_data[group], _group_data[last], _group_shifts[last] * sizeof(uint32_t));
+}
+
+
+// Sort out the received bits into a word for each port in the group that
+// got a good stop bit, and store them.
+void SlowSoftSerialSampler::_store_group(int group, uint32_t done) {
+    uint32_t data;
+    int lane;
+    int i;
+
+    for (lane=0; lane < _lane_count && done != 0; lane++) {
+        if (_lane_bank[lane] != _group_bank[group] || !(done & _lane_mask[lane])) {
+            continue;
+        }
+        done &= ~_lane_mask[lane];
+
+        data = 0;
+        for (i=0; i < _group_shifts[group]; i++) {
+            data >>= 1;
+            if (_group_data[group][i] & _lane_mask[lane]) {
+                data |= _rx_shiftin_bit;
+            }
+        }
+        _lane_port[lane]->_rx_store(data);
+    }
+}
+
+
+void SlowSoftSerialSampler::_timer_handler(void) {
+    uint32_t level[_SSS_SAMPLER_MAX_PORTS];
+    uint32_t starts[_SSS_SAMPLER_MAX_PORTS];
+    uint32_t mask;
+    uint32_t fail;
+    int bank;
+    int group;
+
+    // Read every GPIO port register we need, all at once, and turn each
+    // one into logical levels: 1 for the stop level, 0 for the start level.
+    // A hunting port that was at the stop level last tick and is at the
+    // start level now has found its start bit. This tick takes the place of
+    // the start bit interrupt, so it starts on the op table next tick.
+    for (bank=0; bank < _bank_count; bank++) {
+        level[bank] = *_bank_reg[bank] ^ _bank_inverse[bank];
+        starts[bank] = _bank_hunting[bank] & _bank_prev[bank] & ~level[bank];
+        _bank_hunting[bank] &= ~starts[bank];
+        _bank_prev[bank] = level[bank];
+    }
+
+    // Same operations as SlowSoftSerial::_rx_timer_handler(); see there.
+    // The ports that fail a check go back to hunting.
+    group = 0;
+    while (group < _group_count) {
+        bank = _group_bank[group];
+        mask = _group_mask[group];
+        fail = 0;
+
+        switch (_rx_op_table[_group_op[group]++]) {
+            case _SSS_OP_START:
+                fail = mask & level[bank];
+                break;
+
+            case _SSS_OP_CLEAR:
+                _group_shifts[group] = 0;
+                break;
+
+            case _SSS_OP_VOTE0:
+                _group_bit[group] = level[bank];
+                break;
+
+            case _SSS_OP_VOTE1:
+                fail = mask & (level[bank] ^ _group_bit[group]);
+                break;
+
+            case _SSS_OP_SHIFT:
+                _group_data[group][_group_shifts[group]++] = _group_bit[group];
+                break;
+
+            case _SSS_OP_STOP:
+                fail = mask & ~level[bank];
+                break;
+
+            case _SSS_OP_FINAL:
+                _store_group(group, mask & level[bank]);
+                fail = mask;
+                break;
+
+            case _SSS_OP_NULL:
+            default:
+                break;
+        }
+
+        if (fail) {
+            _bank_hunting[bank] |= fail;
+            _group_mask[group] = mask & ~fail;
+            if (_group_mask[group] == 0) {
+                _drop_group(group);
+                continue;   // the last group moved here, and still needs its turn
+            }
+        }
+        group++;
+    }
+
+    // Ports that found their start bits this tick make new groups
+    for (bank=0; bank < _bank_count; bank++) {
+        if (starts[bank]) {
+            group = _group_count++;
+            _group_bank[group] = bank;
+            _group_op[group] = 0;
+            _group_shifts[group] = 0;
+            _group_mask[group] = starts[bank];
+        }
+    }
 }
@@ -4,17 +4,136 @@
 #include "Stream.h"
 #include "IntervalTimer.h"
 
-#define _SSS_TX_BUFFER_SIZE 64
-#define _SSS_RX_BUFFER_SIZE 64
+// Sizes (in characters) of the buffers built into every port. To save
+// memory, you can build with smaller ones and give the ports that need
+// more their own with addMemoryForRead() and addMemoryForWrite().
+#ifndef SSS_TX_BUFFER_SIZE
+#define SSS_TX_BUFFER_SIZE 64       // all three must be powers of two
+#endif
+#ifndef SSS_RX_BUFFER_SIZE
+#define SSS_RX_BUFFER_SIZE 64
+#endif
+#define _SSS_TX_BLOCKS 4            // blocks queued by queueWrite() at once
 
-#define _SSS_MAX_OPTABLE_SIZE 48  // 4 ops per bit, 8E2 is 12 bits long
+// With SSS_BUFFER_POOL_SIZE defined (in bytes), ports don't have buffers
+// built in. Instead, begin() lends each port its buffers from one pool
+// shared by all the ports, and end() takes them back, so ports that aren't
+// active don't tie up any memory. Ports ask for the sizes above, unless
+// setBufferSizes() says otherwise.
+
+#if (SSS_TX_BUFFER_SIZE & (SSS_TX_BUFFER_SIZE - 1)) || (SSS_RX_BUFFER_SIZE & (SSS_RX_BUFFER_SIZE - 1)) \
+        || (_SSS_TX_BLOCKS & (_SSS_TX_BLOCKS - 1))
+#error "SlowSoftSerial buffer sizes must be powers of two"
+#endif
+
+// The longest data word any port can use. Longer words take bigger buffer
+// words and op tables in every port, so if you need words of 9 to 16 bits,
+// build with this defined to the longest one.
+#ifndef SSS_MAX_DATA_BITS
+#define SSS_MAX_DATA_BITS 8
+#endif
+#if SSS_MAX_DATA_BITS < 4 || SSS_MAX_DATA_BITS > 16
+#error "SSS_MAX_DATA_BITS must be from 4 to 16"
+#endif
+
+// Normally each character in the buffers takes a 16-bit word (32-bit, for
+// words longer than 13 bits), framed and ready to send, or with its parity
+// and noise flags in the top two bits when received. Build with SSS_COMPACT_BUFFERS defined and
+// each character takes a byte instead (plus two bits of flags on receive),
+// and transmit framing is done on the fly, so the same memory holds about
+// twice as many characters. Words can't be longer than 8 bits that way, and
+// peekSpan() gets just the data bits.
+#ifdef SSS_COMPACT_BUFFERS
+#if SSS_MAX_DATA_BITS > 8
+#error "SSS_COMPACT_BUFFERS only holds words of 8 bits or less"
+#endif
+typedef uint8_t sss_buffer_word_t;
+#define _SSS_RX_FLAG_BITS 2         // parity and noise, per received character
+#define _SSS_RX_NOISY 0x80000000    // bits decided by majority vote; kept in the flags
+#define _SSS_RX_PARITY 0x40000000   // received parity bit; kept in the flags
+#elif SSS_MAX_DATA_BITS <= 13       // data, parity, and 2 stop bits in 16
+typedef uint16_t sss_buffer_word_t;
+#define _SSS_RX_FLAG_BITS 0
+#define _SSS_RX_NOISY 0x8000        // bits decided by majority vote
+#define _SSS_RX_PARITY 0x4000       // received parity bit, wherever it was in the frame
+#else
+typedef uint32_t sss_buffer_word_t;
+#define _SSS_RX_FLAG_BITS 0
+#define _SSS_RX_NOISY 0x80000000
+#define _SSS_RX_PARITY 0x40000000
+#endif
+
+// Keeps the compiler from moving buffer accesses across an index update.
+// There's only one core, so that's all the ordering the interrupts need.
+#define _SSS_BARRIER() __asm__ volatile ("" ::: "memory")
+
+#define _SSS_MIN_OVERSAMPLE 2       // receive samples per bit
+#define _SSS_MIN_LATE_OVERSAMPLE 3  // if the start bit can be seen late
+#define _SSS_MAX_OVERSAMPLE 16
+#define SSS_DEFAULT_OVERSAMPLE 4
+
+// The most receive samples per bit that begin() will take. Every sample
+// of the longest character takes a byte of op table in every port, so if
+// you don't need the highest factors, build with this defined lower.
+//
+// Like all the SSS_ settings above, this changes the size and layout of
+// the SlowSoftSerial class. It has to be the same for every file that
+// includes this header and for SlowSoftSerial.cpp, so define it for the
+// whole build (compiler flags, or platform.local.txt in the Arduino IDE),
+// never with #define in the sketch.
+#ifndef SSS_MAX_OVERSAMPLE
+#define SSS_MAX_OVERSAMPLE _SSS_MAX_OVERSAMPLE
+#endif
+#if SSS_MAX_OVERSAMPLE < _SSS_MIN_OVERSAMPLE || SSS_MAX_OVERSAMPLE > _SSS_MAX_OVERSAMPLE
+#error "SSS_MAX_OVERSAMPLE must be from 2 to 16"
+#endif
+
+// Start, data, parity, and 2 stop bits. The op table index is a byte, so
+// the longest words can't have the most samples (16E2 gets up to 12).
+#if SSS_MAX_OVERSAMPLE * (SSS_MAX_DATA_BITS + 4) > 255
+#define _SSS_MAX_OPTABLE_SIZE 255
+#else
+#define _SSS_MAX_OPTABLE_SIZE (SSS_MAX_OVERSAMPLE * (SSS_MAX_DATA_BITS + 4))
+#endif
+
+#define _SSS_MAX_EDGES (SSS_MAX_DATA_BITS + 8)  // edges in one character, with room to spare
 
 #define _SSS_MIN_BAUDRATE 1.0       // arbitrary; don't divide by zero.
 
+#define _SSS_MAX_INSTANCES 8        // active at once; timers are the real limit
+
+#define _SSS_MAX_SAMPLERS 2         // SlowSoftSerialSampler objects active at once
+#define _SSS_SAMPLER_MAX_PORTS _SSS_MAX_INSTANCES
+#define _SSS_SAMPLER_MAX_SHIFTS (SSS_MAX_DATA_BITS + 1)     // data bits plus parity
+
+// Operations of receive processing. These go in the op table to schedule
+// processing that occurs on receive timer interrupts. See design notes.
+#define _SSS_OP_NULL        0
+#define _SSS_OP_START       1
+#define _SSS_OP_CLEAR       2
+#define _SSS_OP_VOTE0       3
+#define _SSS_OP_VOTE1       4
+#define _SSS_OP_SHIFT       5
+#define _SSS_OP_STOP        6
+#define _SSS_OP_FINAL       7
+#define _SSS_OP_COUNT0      8   // like VOTE0, for majority voting
+#define _SSS_OP_COUNT1      9   // like VOTE1, for majority voting
+#define _SSS_OP_DECIDE      10  // like SHIFT, for majority voting
+
 // Definitions for an extension to the ::end() method
 #define SSS_RETAIN_PINS (true)
 #define SSS_RELEASE_PINS (false)
 
+// Definitions for setTimerMode(), which must be called before begin()
+#define SSS_TIMER_DEDICATED (0)     // each port uses two IntervalTimers of its own
+#define SSS_TIMER_SHARED    (1)     // all ports in this mode share one IntervalTimer
+#define SSS_TIMER_SINGLE    (2)     // each port uses one IntervalTimer for both directions
+#define SSS_TIMER_POLLED    (3)     // no IntervalTimer at all; call poll() from loop()
+
+// Definitions for setRxMode(), which must be called before begin()
+#define SSS_RX_SAMPLED      (0)     // sample the RX pin on a timer, usually at 4x the baud rate
+#define SSS_RX_EDGES        (1)     // timestamp every RX pin edge; decode once per character
+
 // Definitions for databits, parity, and stopbits configuration word.
 // These are taken from the official Arduino API, but I've had to rename
 // them because other serial libraries are not consistent with these
@@ -37,6 +156,19 @@
 #define SSS_SERIAL_DATA_8        (0x400ul)
 #define SSS_SERIAL_DATA_MASK     (0xF00ul)
 
+// Longer (and shorter) data words aren't in the Arduino API, so these are our
+// own. They follow on from the official ones, except 4 bits, which had to go
+// at the end. Use write9bit() to send words longer than 8 bits.
+#define SSS_SERIAL_DATA_9        (0x500ul)
+#define SSS_SERIAL_DATA_10       (0x600ul)
+#define SSS_SERIAL_DATA_11       (0x700ul)
+#define SSS_SERIAL_DATA_12       (0x800ul)
+#define SSS_SERIAL_DATA_13       (0x900ul)
+#define SSS_SERIAL_DATA_14       (0xA00ul)
+#define SSS_SERIAL_DATA_15       (0xB00ul)
+#define SSS_SERIAL_DATA_16       (0xC00ul)
+#define SSS_SERIAL_DATA_4        (0xD00ul)
+
 #define SSS_SERIAL_5N1           (SSS_SERIAL_STOP_BIT_1 | SSS_SERIAL_PARITY_NONE  | SSS_SERIAL_DATA_5)
 #define SSS_SERIAL_6N1           (SSS_SERIAL_STOP_BIT_1 | SSS_SERIAL_PARITY_NONE  | SSS_SERIAL_DATA_6)
 #define SSS_SERIAL_7N1           (SSS_SERIAL_STOP_BIT_1 | SSS_SERIAL_PARITY_NONE  | SSS_SERIAL_DATA_7)
@@ -99,6 +231,41 @@
 #define SSS_SERIAL_7S15          (SSS_SERIAL_STOP_BIT_1_5 | SSS_SERIAL_PARITY_SPACE | SSS_SERIAL_DATA_7)
 #define SSS_SERIAL_8S15          (SSS_SERIAL_STOP_BIT_1_5 | SSS_SERIAL_PARITY_SPACE | SSS_SERIAL_DATA_8)
 
+class SlowSoftSerialSampler;
+
+// Everything about a port that follows from its baud rate and configuration
+// word. begin() works it out and puts it into effect right away;
+// queueReconfigure() works it out ahead of time and keeps it until the
+// transmitter gets to the right character.
+struct _SSS_Format {
+    double baudrate;
+    double tx_microseconds;
+    double rx_microseconds;
+    uint32_t tx_ticks;              // whole ticks of the transmit timer's clock
+    uint32_t tx_ticks_frac;         // and the fraction left over, in 1/2^32 ticks
+    uint32_t rx_cycles;             // shared timer or polled
+    uint32_t rx_cycles_frac;
+    uint32_t tx_bit_cycles;         // burst transmit
+    uint32_t rx_bit_cycles;         // edge and burst receive
+    uint32_t rx_final_cycles;       // edge receive
+    uint16_t parity;
+    uint32_t parity_bit;
+    uint32_t stop_bits;
+    uint32_t tx_framing[2];
+    uint16_t databits_mask;
+    uint32_t rx_shiftin_bit;
+    uint8_t num_bits_to_send;
+    uint8_t rx_bits;
+    uint8_t tx_bits;                // the same, but goes with transmit
+    bool tx_halfbaud;
+    bool tx_burst;
+    bool rx_burst;
+    bool rx_by_edges;
+    bool rx_late_start;             // op table already allows for a late start bit
+    int rx_vote_samples;
+    uint8_t rx_op_table[_SSS_MAX_OPTABLE_SIZE];
+};
+
 class SlowSoftSerial : public Stream
 {
   public:
@@ -107,21 +274,122 @@ class SlowSoftSerial : public Stream
 
     // Note we use a floating point value for baud rate. We can do that!
     // And if legacy code passes an integral value, it just gets converted.
-    void begin(double baudrate, uint16_t config);
+    // You can also choose how many times per bit to sample on receive.
+    // More samples give more noise immunity, fewer give fewer interrupts.
+    void begin(double baudrate, uint16_t config, uint8_t oversample);
+    void begin(double baudrate, uint16_t config) { begin(baudrate, config, SSS_DEFAULT_OVERSAMPLE); }
     void begin(double baudrate) { begin(baudrate, SSS_SERIAL_8N1); }
 
     void end(bool releasePins);
     void end() { end(SSS_RELEASE_PINS); }
 
+    // Teensy processors only have two or four IntervalTimers, and we need
+    // two per port. In single mode, we need just one per port. In shared mode,
+    // any number of ports can share one timer, at some cost in timing jitter.
+    // You can check on the worst-case lateness (in microseconds) to see
+    // whether the shared timer is keeping up.
+    // In polled mode, we don't use a timer at all. You call poll() from
+    // loop() at least once per receive sample time (a quarter bit, by
+    // default) and it sends and samples whatever bits are due. That's only
+    // practical at low baud rates, but it costs next to nothing in interrupts.
+    void setTimerMode(uint8_t mode);
+    static float sharedTimerLateness(void);
+    static void resetSharedTimerLateness(void);
+    void poll(void);
+
+    // Timers count whole ticks of some clock, so they can't hit most baud
+    // rates exactly. We carry the fraction of a tick over from each bit to
+    // the next, so the long-run baud rate is right, but each bit can still
+    // be off by up to a tick. These tell you the baud rate you're actually
+    // getting on transmit, and the worst error in the length of any one bit,
+    // transmit or receive, as a fraction of a bit time. Call after begin().
+    double actualBaudRate(void);
+    float maxBitError(void);
+
+    // Normally we sample the RX pin several times per bit. In edge mode, we
+    // take an interrupt only when the RX pin changes, which makes higher
+    // baud rates possible in the presence of interrupt latency. Edge mode
+    // only works with SSS_TIMER_DEDICATED; otherwise it's ignored.
+    void setRxMode(uint8_t mode);
+
+    // Normally, a character is thrown away if the samples of any bit don't
+    // all agree. With majority voting, each bit goes by the majority of its
+    // samples instead. You can tell which characters had bits outvoted by
+    // noise, and count the outvoted bits. Call before begin().
+    // It takes at least 3 samples in the middle of each bit, so begin()
+    // fails unless the oversampling factor is 4 or at least 6 (at least 6
+    // in SSS_TIMER_SINGLE mode, which can drop the last sample in a bit).
+    void setMajorityVote(bool enable);
+    bool peekNoisy(void);
+    uint32_t correctedBits(void);
+    void resetCorrectedBits(void);
+
+    // At high baud rates, an interrupt for every bit costs too much. In burst
+    // mode, one transmit interrupt sends a whole character, busy-waiting
+    // between bits. That holds off other interrupts for most of a character
+    // time, so it only happens if a character (less the stop bits) fits in
+    // the latency budget you allow, in microseconds. Otherwise, and in the
+    // other timer modes, it's one interrupt per bit as usual. Call before begin().
+    void setTxBurst(float maxMicroseconds);
+
+    // Likewise, in burst receive mode the start bit interrupt receives the
+    // whole character itself, sampling the middle of each bit, instead of
+    // starting a timer to sample each bit several times. The latency budget
+    // has to cover the character up to the middle of the stop bit. Edge mode
+    // and majority voting don't apply to burst receive. As with transmit, it
+    // only happens in SSS_TIMER_DEDICATED mode, so the busy-wait can't hold up
+    // a timer other ports are counting on. Call before begin().
+    void setRxBurst(float maxMicroseconds);
+
+    // Give the port your own memory for a bigger (or smaller) receive or
+    // transmit buffer, as with Teensy's hardware serial ports. Unlike theirs,
+    // the memory takes the place of the built-in buffer instead of adding to
+    // it. Each character takes a buffer word (see sss_buffer_word_t above: 2
+    // bytes, or 4 for words longer than 13 bits, or 1 byte and 2 bits of flags
+    // on receive with SSS_COMPACT_BUFFERS), and the buffer holds the largest
+    // power of two characters that fits. Call before begin().
+    void addMemoryForRead(void *buffer, size_t size);
+    void addMemoryForWrite(void *buffer, size_t size);
+
+    // With a buffer pool (see SSS_BUFFER_POOL_SIZE), the number of characters
+    // to borrow for each buffer in begin(). If there isn't that much free,
+    // begin() takes half as much, and so on. Call before begin().
+    void setBufferSizes(uint32_t txChars, uint32_t rxChars);
+
     int available(void);
     int availableForWrite(void);
     int peek(void);
     int read(void);
+    size_t read(uint8_t *buffer, size_t size);  // doesn't wait; 8 bits or less only
+
+    // For parsing received characters in place: peekSpan() points at as many
+    // as are waiting in one piece of the receive buffer, and returns how many.
+    // Each word holds a character in its low bits, with the parity bit and
+    // a flag in the top two bits (except with SSS_COMPACT_BUFFERS), so mask
+    // them off as peek() would. Then consume() the ones you're done with.
+    int peekSpan(const sss_buffer_word_t **words);
+    void consume(int count);
     void flush(void);
-    size_t write(uint8_t);
+    size_t write(uint8_t chr) { return write9bit(chr); }
+    size_t write9bit(uint32_t word);    // like Teensy's; any word length up to SSS_MAX_DATA_BITS
+    size_t write(const uint8_t *buffer, size_t size);
     using Print::write; // pull in write(str) and write(buf, size) from Print
 
-    operator bool() { return true; };   // we are always ready
+    // Send a block of characters straight out of your buffer, without copying
+    // and without waiting for it to go. Don't touch the buffer until the
+    // callback, which is called (from interrupt context) once the block's
+    // last stop bit has gone out. False if too many blocks are queued.
+    bool queueWrite(const uint8_t *buffer, size_t size,
+                    void (*callback)(void *context) = NULL, void *context = NULL);
+
+    // Change the baud rate and configuration word in step with the data:
+    // everything written (or queued) before this goes out the old way, and
+    // everything after it the new way. Receive switches over between
+    // characters. Only in SSS_TIMER_DEDICATED mode without a sampler.
+    // False if it can't be done, or if a change is already waiting.
+    bool queueReconfigure(double baudrate, uint16_t config);
+
+    operator bool() { return _instance_active; };   // false if begin() failed
 
     // listen is a SoftwareSerial thing, since it can only receive on one port.
     // We don't have that limitation, though we are limited by the number of timers.
@@ -130,69 +398,266 @@ class SlowSoftSerial : public Stream
 
     // The standard Arduino serial API doesn't support handshaking, but the
     // Teensyduino UART API does support hardware handshaking. We adopt their
-    // API.
-    // void attachRts(uint8_t); not yet implemented
+    // API. Call these after begin().
+    // RTS holds off the sender once highWater characters are waiting in the
+    // receive buffer, and lets it go again once reading gets them down to
+    // lowWater. Zero picks three quarters and one quarter of the buffer,
+    // which leaves room for a sender that's slow to notice.
+    void attachRts(uint8_t pin, int highWater = 0, int lowWater = 0);
     void attachCts(uint8_t);
 
     // Unfortunately, this has to be public because of the horrific workaround
     // needed to register a callback with IntervalTimer or attachInterrupt.
-    void _tx_baud_handler(void);
-    void _tx_halfbaud_handler(void);
-    bool _tx_halfbaud;          // flag: double the interrupt rate for 1.5 stop bits case
+    void _tx_handler(void);
     void _rx_timer_handler(void);
     void _rx_start_handler(void);
+    void _single_handler(void);
+    void _rx_edge_handler(void);
+    void _rx_decode_handler(void);
+    static void _sched_dispatch(void);
 
   private:
-    static int _active_count;
+    friend class SlowSoftSerialSampler;
+    SlowSoftSerialSampler *_sampler;    // if not NULL, it's doing our receiving
+
     bool _instance_active;
+    int _slot;                      // index into the table of active instances; -1 if not active
+
+    uint8_t _timer_mode;
+    bool _timers_available(void);
+    bool _tx_timer_start(void);
+    uint32_t _tx_frame(uint32_t word);
+    sss_buffer_word_t _tx_to_buffer(uint32_t word);
+    uint32_t _tx_from_buffer(sss_buffer_word_t word);
+    int _tx_commit(int count);
+    void _tx_next_char(void);
+    uint32_t _tx_take_char(void);
+    void _tx_burst_char(uint32_t data_as_sent);
+    void _tx_block_finish(void);
+    void _tx_timer_stop(void);
+    void _tx_timer_update(bool stretch);
+    bool _rx_timer_start(void);
+    void _rx_timer_stop(void);
+    uint32_t _rx_next_cycles(void);
+    void _rx_hunt(void);
+    void _rx_store(uint32_t data_word);
+    bool _borrow_buffers(void);
+    void _return_buffers(void);
+    uint32_t _rx_word(uint32_t index);
+
+    // single timer mode
+    bool _single_timer_start(void);
+    void _single_timer_stop(void);
+    volatile bool _single_running;  // the one timer is running
+    volatile bool _single_tx;       // transmit is using the timer
+    volatile uint8_t _single_rx;    // receive state in single timer mode
+    uint8_t _single_tx_ticks;       // countdown of ticks to the next transmit interrupt
+    uint8_t _single_tx_divider;     // ticks per transmit interrupt
+    uint8_t _single_tx_next;        // ticks in the transmit interval after this one
+
+    // polled mode
+    uint32_t _poll_tx_deadline;     // CPU cycle count when the next transmit bit is due
+    uint32_t _poll_rx_deadline;     // and the next receive sample
+    volatile bool _poll_tx;         // transmit is waiting on its deadline
+    volatile bool _poll_rx;         // receive is waiting on its deadline
+
+    // edge timestamp receive
+    bool _rx_decode_timer_start(uint32_t t0);
+    uint8_t _rx_mode;               // as requested by setRxMode()
+    bool _rx_by_edges;              // edge mode actually in effect
+    uint8_t _rx_bits;               // data and parity bits per character
+    uint32_t _rx_bit_cycles;        // one bit time in CPU cycles (edges or burst)
+    uint32_t _rx_final_cycles;      // from start bit edge to decoding, in CPU cycles
+    volatile uint8_t _rx_edge_count;
+    bool _rx_edge_overrun;          // more edges than a character can have
+    uint32_t _rx_edges[_SSS_MAX_EDGES];     // edge times in CPU cycles
 
-    uint16_t _add_parity(uint8_t chr);
-    void _fill_op_table(int rxbits, int stopbits);
+    // burst receive
+    void _rx_burst_char(void);
+    float _rx_burst_budget;         // as requested by setRxBurst()
+    bool _rx_burst;                 // burst receive actually in effect
+
+    // shared timer scheduling
+    bool _sched_timer_available(void);
+    bool _sched_add(uint8_t event, uint32_t deadline);
+    void _sched_remove(uint8_t event);
+
+    bool _compute_format(double baudrate, uint16_t config, _SSS_Format *f);
+    bool _set_frame_format(uint16_t config, _SSS_Format *f);
+    void _fill_tx_framing(_SSS_Format *f);
+    bool _fill_op_table(_SSS_Format *f, int rxbits, int stopbits);
+    void _apply_tx_format(const _SSS_Format *f);
+    void _apply_rx_format(const _SSS_Format *f);
+    void _reconfigure(void);
 
     // port configuration
-    double _tx_microseconds;        // transmit interrupt duration (1x or 2x the baud rate)
-    double _rx_microseconds;        // receive sample duration (4x the baud rate)
-    uint16_t _parity;               // use definitions above, like ones in HardwareSerial.h
+    double _baudrate;               // as given to begin() or queueReconfigure()
+    double _tx_microseconds;        // transmit interrupt duration (1x the baud rate, or a character)
+    double _rx_microseconds;        // receive sample duration (usually 4x the baud rate)
+    uint8_t _rx_oversample;         // receive samples per bit
+    float _tx_burst_budget;         // as requested by setTxBurst()
+    bool _tx_burst;                 // burst transmit actually in effect
+    uint32_t _tx_bit_cycles;        // one bit time in CPU cycles (burst transmit)
+    uint32_t _tx_ticks;             // transmit interrupt duration in whole timer ticks (or CPU cycles)
+    uint32_t _tx_ticks_frac;        // and the fraction of a tick, in 1/2^32 ticks
+    uint32_t _tx_phase;             // fractions of a tick carried so far
+    uint32_t _tx_next_cycles;       // transmit interval after this one, 1 or 1.5 bits (shared or polled)
+    uint32_t _rx_cycles;            // receive sample duration in CPU cycles (shared or polled)
+    uint32_t _rx_cycles_frac;       // and the fraction of a cycle, in 1/2^32 cycles
+    uint32_t _rx_phase;
     uint8_t _num_bits_to_send;      // includes parity and stop bit(s) but not start bit
-    uint16_t _parity_bit;           // bitmask for the parity bit; 0 if no parity
-    int16_t _stop_bits;             // bit(s) to OR in to data word
-    uint8_t _databits_mask;         // bitmask of bits that fit in the word size
-    uint16_t _rx_shiftin_bit;       // bit to OR in to data word as received bits shift in
+    uint8_t _tx_bits;               // data and parity bits per character sent
+    bool _tx_halfbaud;              // flag: 1.5 stop bits, so the stop bit interval is stretched
+    uint32_t _parity_bit;           // bitmask for the parity bit; 0 if no parity
+    uint32_t _tx_framing[2];        // parity and stop bits to OR in, for even and odd characters
+    uint32_t _tx_invert;            // to XOR in for inverted signaling
+    uint16_t _databits_mask;        // bitmask of bits that fit in the word size, for transmit
+    uint16_t _rx_databits_mask;     // and for receive, which may be behind during a reconfigure
+    uint32_t _rx_shiftin_bit;       // bit to OR in to data word as received bits shift in
     uint8_t _rxPin;
     uint8_t _txPin;
     uint8_t _rtsPin;
     uint8_t _ctsPin;
     bool _rts_attached;
     bool _cts_attached;
+    volatile bool _rts_held;        // RTS is telling the sender to wait
+    uint32_t _rts_high_water;       // characters waiting when RTS holds off the sender
+    uint32_t _rts_low_water;        // characters waiting when RTS lets it go again
     bool _inverse;
     IntervalTimer _tx_timer;
     IntervalTimer _rx_timer;    
 
     // transmit buffer and its variables
-    volatile int _tx_buffer_count;
-    int _tx_write_index;
-    int _tx_read_index;
-    uint16_t _tx_buffer[_SSS_TX_BUFFER_SIZE]; // contains data "as sent" with parity and stop bits
+    // The indexes count up forever and get masked to the buffer size; the
+    // difference between them is the number of characters waiting. Only the
+    // foreground moves the write index and only the interrupt moves the read
+    // index, so neither has to lock the other out.
+    volatile uint32_t _tx_write_index;
+    volatile uint32_t _tx_read_index;
+    sss_buffer_word_t *_tx_buffer;  // contains data "as sent" with parity and stop bits, or just data if compact
+    uint32_t _tx_buffer_mask;       // size of the buffer, less one
+    uint32_t _tx_buffer_want;       // as requested by setBufferSizes()
+#ifndef SSS_BUFFER_POOL_SIZE
+    sss_buffer_word_t _tx_buffer_builtin[SSS_TX_BUFFER_SIZE];
+#endif
 
     // transmit state
-    int _tx_data_word;
+    uint32_t _tx_data_word;
     int _tx_bit_count;
     bool _tx_enabled = true;
-    bool _tx_running = false;
-    bool _tx_baud_divider;      // in 1.5 stop bit case, toggles 0 1 to halve the interrupt rate
-    bool _tx_extra_half_stop;   // flag: we need to add an extra half stop bit to this character
+    volatile bool _tx_running = false;
+
+    // blocks queued for transmit by queueWrite(), and the one being sent
+    const uint8_t *_tx_block_buffer[_SSS_TX_BLOCKS];
+    size_t _tx_block_size[_SSS_TX_BLOCKS];
+    void (*_tx_block_callback[_SSS_TX_BLOCKS])(void *);
+    void *_tx_block_context[_SSS_TX_BLOCKS];
+    uint32_t _tx_block_at[_SSS_TX_BLOCKS];  // goes out when _tx_read_index gets here
+    volatile uint32_t _tx_block_head;   // moved only by the interrupt, like _tx_read_index
+    volatile uint32_t _tx_block_tail;   // moved only by queueWrite()
+    const uint8_t *_tx_block_next;  // next character of the block being sent
+    size_t _tx_block_remaining;
+    volatile bool _tx_block_active; // sending from a block instead of the transmit buffer
+    bool _tx_block_finishing;       // the block's last character is on its way out
+
+    // a change of format waiting for queueReconfigure()
+    _SSS_Format _reconfig;
+    uint32_t _reconfig_at;          // takes effect when _tx_read_index gets here
+    uint32_t _reconfig_blocks;      // and _tx_block_head gets here
+    volatile bool _reconfig_pending;    // transmit hasn't switched yet
+    volatile bool _rx_reconfig_due;     // transmit has, receive hasn't
+    volatile bool _rx_active;       // receive timer is running for a character
 
     // receive buffer and its variables
-    volatile int _rx_buffer_count;
-    int _rx_write_index;
-    int _rx_read_index;
-    uint16_t _rx_buffer[_SSS_RX_BUFFER_SIZE]; // contains data with parity (no stop bits)
+    // Same scheme as the transmit buffer, but the interrupt moves the write
+    // index and the foreground moves the read index.
+    volatile uint32_t _rx_write_index;
+    volatile uint32_t _rx_read_index;
+    sss_buffer_word_t *_rx_buffer;  // contains data with parity (no stop bits), or just data if compact
+    uint32_t _rx_buffer_mask;       // size of the buffer, less one
+    uint32_t _rx_buffer_want;
+#ifndef SSS_BUFFER_POOL_SIZE
+    sss_buffer_word_t _rx_buffer_builtin[SSS_RX_BUFFER_SIZE];
+#endif
+#ifdef SSS_COMPACT_BUFFERS
+    uint8_t *_rx_flags;             // parity and noise bits, four characters per byte
+#ifndef SSS_BUFFER_POOL_SIZE
+    uint8_t _rx_flags_builtin[(SSS_RX_BUFFER_SIZE * _SSS_RX_FLAG_BITS + 7) / 8];
+#endif
+#endif
 
     // receive state
     uint8_t _rx_op_table[_SSS_MAX_OPTABLE_SIZE];
+    bool _rx_late_start;      // op table already allows for a late start bit
     uint8_t _rx_op;           // index into the operation table
-    uint16_t _rx_data_word;   // word under construction as we receive it
-    int _rx_bit_value;        // bit value as we sample it repeatedly
+    uint32_t _rx_data_word;   // word under construction as we receive it
+    int _rx_bit_value;        // bit value as we sample it repeatedly (or count of 1s, voting)
+
+    // majority voting
+    bool _rx_majority;
+    bool _rx_noisy;           // some bit in this character was outvoted
+    int _rx_vote_samples;     // samples per bit
+    volatile uint32_t _rx_corrected_bits;
 
 };
 
+
+
+// One timer interrupt that receives for many ports at once. All the ports
+// attached to a sampler must already be begun with the same baud rate and
+// configuration. The sampler takes over their receive side, so they don't
+// need any receive timers or start bit interrupts of their own. The sampler
+// runs its timer continuously as long as any port is attached, though.
+class SlowSoftSerialSampler
+{
+  public:
+    SlowSoftSerialSampler();
+    ~SlowSoftSerialSampler() { end(); }
+
+    bool attach(SlowSoftSerial &port);  // false if incompatible, full, or no timer
+    void detach(SlowSoftSerial &port);
+    void end(void);                     // detach all the ports
+
+    // Unfortunately, this has to be public because of the horrific workaround
+    // needed to register a callback with IntervalTimer.
+    void _timer_handler(void);
+
+  private:
+    int _find_bank(volatile uint32_t *reg);
+    void _drop_bank(int bank);
+    void _drop_group(int group);
+    void _store_group(int group, uint32_t done);
+
+    int _slot;                      // index into the table of active samplers
+    IntervalTimer _timer;
+    double _rx_microseconds;        // sample duration, same for all the ports
+    uint32_t _rx_shiftin_bit;       // same for all the ports
+    uint8_t _rx_op_table[_SSS_MAX_OPTABLE_SIZE];    // same for all the ports
+
+    // The distinct GPIO input registers we need to read. Each port is just
+    // one bit of its bank's register, so the per-bank state is bit masks.
+    int _bank_count;
+    volatile uint32_t *_bank_reg[_SSS_SAMPLER_MAX_PORTS];
+    uint32_t _bank_lanes[_SSS_SAMPLER_MAX_PORTS];   // bits of the ports in this bank
+    uint32_t _bank_inverse[_SSS_SAMPLER_MAX_PORTS]; // bits of the inverted ports
+    uint32_t _bank_hunting[_SSS_SAMPLER_MAX_PORTS]; // bits of the ports waiting for a start bit
+    uint32_t _bank_prev[_SSS_SAMPLER_MAX_PORTS];    // previous levels, to find start edges
+
+    // Ports in the same bank that found their start bits on the same tick
+    // are at the same place in the op table from then on, so they go
+    // through it together as a group, with every operation done on all of
+    // them at once.
+    int _group_count;
+    uint8_t _group_bank[_SSS_SAMPLER_MAX_PORTS];
+    uint8_t _group_op[_SSS_SAMPLER_MAX_PORTS];      // index into the op table
+    uint8_t _group_shifts[_SSS_SAMPLER_MAX_PORTS];  // bits received so far
+    uint32_t _group_mask[_SSS_SAMPLER_MAX_PORTS];   // bits of the ports still in the group
+    uint32_t _group_bit[_SSS_SAMPLER_MAX_PORTS];    // bit values as we sample them repeatedly
+    uint32_t _group_data[_SSS_SAMPLER_MAX_PORTS][_SSS_SAMPLER_MAX_SHIFTS];  // bit values as received
+
+    // The ports themselves, by lane
+    volatile int _lane_count;
+    SlowSoftSerial *_lane_port[_SSS_SAMPLER_MAX_PORTS];
+    uint8_t _lane_bank[_SSS_SAMPLER_MAX_PORTS];     // which GPIO register
+    uint32_t _lane_mask[_SSS_SAMPLER_MAX_PORTS];    // which bit in the GPIO register
+};
@@ -0,0 +1,402 @@
+#pragma once
+
+// SlowSoftSerialT is a version of SlowSoftSerial for boards with fixed wiring.
+// The pins, the configuration word, and the inverse flag are template
+// parameters instead of member variables. Everything that depends on them
+// (the op table, the stop bits and parity bit, the signal levels) is worked
+// out by the compiler, and with constant pin numbers digitalReadFast() and
+// digitalWriteFast() compile down to a single register access. That makes
+// the interrupt handlers about as short as they can be.
+//
+//      SlowSoftSerialT<7, 8, SSS_SERIAL_7E1> port;
+//      port.begin(300);
+//
+// The buffer sizes, in characters, can follow as template parameters too.
+// They have to be powers of two. A port you only write to can get by with
+// a tiny receive buffer:
+//
+//      SlowSoftSerialT<7, 8, SSS_SERIAL_8N1, false, 256, 2> printer;
+//
+// This only does the basics: two dedicated IntervalTimers, 4x sampling,
+// and the Stream API. For anything fancier, use SlowSoftSerial.
+// Since the pins are part of the type, there can only be one active
+// instance of each type.
+
+#include "Arduino.h"
+#include "SlowSoftSerial.h"     // for the configuration and op definitions
+
+
+// The receive op table, generated at compile time. It's the same table
+// SlowSoftSerial::_fill_op_table() makes at 4x oversampling.
+template <int rxbits, int stop_halves>
+struct _SSS_OpTable {
+    static constexpr int size = 4 * (1 + rxbits) + 2 * stop_halves - 1;
+    uint8_t op[size];
+
+    constexpr _SSS_OpTable() : op{} {
+        int i = 0;      // (constexpr needs every variable initialized)
+
+        op[i++] = _SSS_OP_START;
+        op[i++] = _SSS_OP_START;
+        op[i++] = _SSS_OP_START;
+        op[i++] = _SSS_OP_CLEAR;
+        for (int bit=0; bit < rxbits; bit++) {
+            op[i++] = _SSS_OP_VOTE0;
+            op[i++] = _SSS_OP_VOTE1;
+            op[i++] = _SSS_OP_VOTE1;
+            op[i++] = _SSS_OP_SHIFT;
+        }
+        for (int tick=1; tick < 2 * stop_halves - 1; tick++) {
+            op[i++] = _SSS_OP_STOP;
+        }
+        op[i++] = _SSS_OP_FINAL;
+    }
+};
+
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config = SSS_SERIAL_8N1, bool inverse = false,
+          uint16_t txSize = SSS_TX_BUFFER_SIZE, uint16_t rxSize = SSS_RX_BUFFER_SIZE>
+class SlowSoftSerialT : public Stream
+{
+  public:
+    ~SlowSoftSerialT() { end(); }
+
+    void begin(double baudrate);
+    void end(bool releasePins);
+    void end() { end(SSS_RELEASE_PINS); }
+
+    int available(void) { return _rx_write_index - _rx_read_index; }
+    int availableForWrite(void) { return txSize - (_tx_write_index - _tx_read_index); }
+    int peek(void);
+    int read(void);
+    void flush(void);
+    size_t write(uint8_t);
+    using Print::write; // pull in write(str) and write(buf, size) from Print
+
+    operator bool() { return _instance == this; }   // false if begin() failed
+
+  private:
+    // Everything about the configuration, worked out at compile time
+    static constexpr uint16_t _parity = config & SSS_SERIAL_PARITY_MASK;
+    static constexpr uint16_t _stop = config & SSS_SERIAL_STOP_BIT_MASK;
+    static constexpr int _databits = ((config & SSS_SERIAL_DATA_MASK) >> 8) + 4;
+    static constexpr int _rxbits = _databits + (_parity != SSS_SERIAL_PARITY_NONE);
+    static constexpr int _stop_halves = (_stop == SSS_SERIAL_STOP_BIT_1) ? 2 : (_stop == SSS_SERIAL_STOP_BIT_1_5) ? 3 : 4;
+    static constexpr bool _halfbaud = (_stop == SSS_SERIAL_STOP_BIT_1_5);
+    static constexpr int _num_bits_to_send = _rxbits + ((_stop == SSS_SERIAL_STOP_BIT_2) ? 2 : 1);
+    static constexpr uint16_t _stop_bits = ((_stop == SSS_SERIAL_STOP_BIT_1) ? 0x1 : 0x3) << _rxbits;
+    static constexpr uint16_t _parity_bit = (_parity == SSS_SERIAL_PARITY_NONE) ? 0 : 1 << _databits;
+    static constexpr uint8_t _databits_mask = (1 << _databits) - 1;
+    static constexpr uint16_t _rx_shiftin_bit = 1 << (_rxbits - 1);
+    static constexpr uint8_t _start_level = inverse ? HIGH : LOW;
+    static constexpr uint8_t _stop_level = inverse ? LOW : HIGH;
+
+    static_assert(_databits >= 5 && _databits <= 8, "SlowSoftSerialT: unsupported data word length");
+    static_assert(_parity >= SSS_SERIAL_PARITY_EVEN && _parity <= SSS_SERIAL_PARITY_SPACE, "SlowSoftSerialT: unsupported parity");
+    static_assert(_stop >= SSS_SERIAL_STOP_BIT_1 && _stop <= SSS_SERIAL_STOP_BIT_2, "SlowSoftSerialT: unsupported stop bits");
+    static_assert(txSize > 0 && (txSize & (txSize - 1)) == 0, "SlowSoftSerialT: buffer sizes must be powers of two");
+    static_assert(rxSize > 0 && (rxSize & (rxSize - 1)) == 0, "SlowSoftSerialT: buffer sizes must be powers of two");
+
+    typedef _SSS_OpTable<_rxbits, _stop_halves> _op_table_t;
+    static constexpr _op_table_t _rx_op_table = _op_table_t();
+
+    // With the pins in the type, one static instance pointer is all the
+    // callbacks need.
+    static SlowSoftSerialT *_instance;
+    static void _tx_isr(void) { _instance->_tx_handler(); }
+    static void _rx_timer_isr(void) { _instance->_rx_timer_handler(); }
+    static void _rx_start_isr(void) { _instance->_rx_start_handler(); }
+
+    void _tx_handler(void);
+    void _tx_next_char(void);
+    void _rx_timer_handler(void);
+    void _rx_start_handler(void);
+    void _rx_hunt(void);
+
+    double _tx_microseconds;
+    double _rx_microseconds;
+    IntervalTimer _tx_timer;
+    IntervalTimer _rx_timer;
+
+    // transmit buffer and its variables, free-running indexes as in SlowSoftSerial
+    volatile uint32_t _tx_write_index;
+    volatile uint32_t _tx_read_index;
+    uint16_t _tx_buffer[txSize]; // contains data "as sent" with parity and stop bits
+
+    // transmit state
+    uint16_t _tx_data_word;
+    uint8_t _tx_bit_count;
+    volatile bool _tx_running;
+
+    // receive buffer and its variables
+    volatile uint32_t _rx_write_index;
+    volatile uint32_t _rx_read_index;
+    uint16_t _rx_buffer[rxSize]; // contains data with parity (no stop bits)
+
+    // receive state
+    uint8_t _rx_op;             // index into the operation table
+    uint16_t _rx_data_word;     // word under construction as we receive it
+    uint8_t _rx_bit_value;      // bit value as we sample it repeatedly
+};
+
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize> *SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::_instance = NULL;
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+constexpr typename SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::_op_table_t SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::_rx_op_table;
+
+
+///////////////////////////////////////////////////////////////////////
+//  Public Member Functions
+///////////////////////////////////////////////////////////////////////
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+void SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::begin(double baudrate) {
+    if (_instance != NULL || baudrate < _SSS_MIN_BAUDRATE) {
+        return;     // failure, already active or nonsense baud rate
+    }
+
+    _tx_microseconds = 1000000.0/baudrate;
+    _rx_microseconds = 250000.0/baudrate;
+
+    // We only hold the timers while we're actually sending or receiving,
+    // but there's no point in starting up if they can't be had at all.
+    if (!_tx_timer.begin(_tx_isr, _tx_microseconds)) {
+        return;
+    }
+    if (!_rx_timer.begin(_rx_timer_isr, _rx_microseconds)) {
+        _tx_timer.end();
+        return;
+    }
+    _tx_timer.end();
+    _rx_timer.end();
+
+    // Writing both before and after eliminates a potential glitch.
+    digitalWriteFast(txPin, _stop_level);
+    pinMode(txPin, OUTPUT);
+    digitalWriteFast(txPin, _stop_level);
+
+    _tx_write_index = 0;
+    _tx_read_index = 0;
+    _tx_bit_count = 0;
+    _tx_running = false;
+
+    pinMode(rxPin, inverse ? INPUT_PULLDOWN : INPUT_PULLUP);
+
+    _rx_write_index = 0;
+    _rx_read_index = 0;
+
+    _instance = this;
+    attachInterrupt(digitalPinToInterrupt(rxPin), _rx_start_isr, inverse ? RISING : FALLING);
+}
+
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+void SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::end(bool releasePins) {
+    if (_instance != this) {
+        return;
+    }
+
+    _tx_timer.end();    // called first to avoid any conflict for variables
+    _rx_timer.end();
+    detachInterrupt(digitalPinToInterrupt(rxPin));
+
+    if (releasePins == SSS_RELEASE_PINS) {
+        pinMode(txPin, INPUT);
+        pinMode(rxPin, INPUT);
+    }
+
+    _tx_read_index = _tx_write_index;
+    _tx_running = false;
+    _instance = NULL;
+}
+
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+int SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::peek(void) {
+    if (_rx_write_index != _rx_read_index) {
+        return _rx_buffer[_rx_read_index & (rxSize - 1)] & _databits_mask;
+    } else {
+        return -1;      // nothing available to peek
+    }
+}
+
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+int SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::read(void) {
+    int chr = peek();
+
+    if (chr != -1) {
+        _SSS_BARRIER();
+        _rx_read_index++;
+    }
+
+    return chr;
+}
+
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+void SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::flush(void) {
+    while (_tx_write_index != _tx_read_index || _tx_running) {
+        yield();
+    }
+}
+
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+size_t SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::write(uint8_t chr) {
+    uint16_t data_as_sent;
+
+    chr &= _databits_mask;
+
+    // All the parity tests but one fold away at compile time.
+    data_as_sent = chr | _stop_bits;
+    if (_parity == SSS_SERIAL_PARITY_MARK
+      || (_parity == SSS_SERIAL_PARITY_EVEN && __builtin_parity(chr))
+      || (_parity == SSS_SERIAL_PARITY_ODD && !__builtin_parity(chr))) {
+        data_as_sent |= _parity_bit;
+    }
+    if (inverse) {
+        data_as_sent ^= 0xFFFF;
+    }
+
+    // Arduino Stream semantics require a blocking write()
+    while (availableForWrite() <= 0) {
+        yield();
+    }
+
+    _tx_buffer[_tx_write_index & (txSize - 1)] = data_as_sent;
+    _SSS_BARRIER();
+    _tx_write_index++;
+
+    // Start the baud rate interrupt if it isn't already running, and send
+    // the start bit right now, as SlowSoftSerial does. The first interrupt
+    // comes one bit time later to send the first data bit.
+    if (!_tx_running) {
+        noInterrupts();
+        if (_tx_timer.begin(_tx_isr, _tx_microseconds)) {
+            _tx_running = true;
+            _tx_next_char();
+        }
+        interrupts();
+    }
+
+    return 1;     // We "sent" the one character
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//  Private Functions
+///////////////////////////////////////////////////////////////////////
+
+// Same as SlowSoftSerial::_tx_handler(). Except in the 1.5 stop bit case,
+// the compiler leaves out stretching the stop bit interval entirely.
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+void SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::_tx_handler(void) {
+    if (_tx_bit_count > 0) {
+        // We're in the middle of sending a character, keep sending it
+        digitalWriteFast(txPin, _tx_data_word & 0x01);
+        _tx_data_word >>= 1;
+        if (_halfbaud && _tx_bit_count <= 2) {
+            _tx_timer.update(_tx_bit_count == 2 ? _tx_microseconds * 1.5 : _tx_microseconds);
+        }
+        _tx_bit_count--;
+        return;
+    }
+
+    if (_tx_write_index == _tx_read_index) {
+        // Nothing more to transmit right now, shut it down
+        _tx_running = false;
+        _tx_timer.end();
+        digitalWriteFast(txPin, _stop_level);  // just to be sure
+        return;
+    }
+
+    _tx_next_char();
+}
+
+
+// Get the next character and begin to send it, starting with the start bit.
+// Called from the transmit interrupt, or from write() with interrupts disabled.
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+void SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::_tx_next_char(void) {
+    _tx_data_word = _tx_buffer[_tx_read_index & (txSize - 1)];
+    _SSS_BARRIER();
+    _tx_read_index++;
+    digitalWriteFast(txPin, _start_level);
+    _tx_bit_count = _num_bits_to_send;
+}
+
+
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+void SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::_rx_start_handler(void) {
+    _rx_op = 0;
+    if (_rx_timer.begin(_rx_timer_isr, _rx_microseconds)) {
+        detachInterrupt(digitalPinToInterrupt(rxPin));
+    }
+}
+
+
+// Stop the receive timer and go back to waiting for a start bit.
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+void SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::_rx_hunt(void) {
+    _rx_timer.end();
+    attachInterrupt(digitalPinToInterrupt(rxPin), _rx_start_isr, inverse ? RISING : FALLING);
+}
+
+
+// Same as SlowSoftSerial::_rx_timer_handler(); see there for commentary.
+template <uint8_t rxPin, uint8_t txPin, uint16_t config, bool inverse, uint16_t txSize, uint16_t rxSize>
+void SlowSoftSerialT<rxPin, txPin, config, inverse, txSize, rxSize>::_rx_timer_handler(void) {
+
+    switch (_rx_op_table.op[_rx_op++]) {
+        case _SSS_OP_START:
+            if (digitalReadFast(rxPin) != _start_level) {
+                _rx_hunt();
+            }
+            break;
+
+        case _SSS_OP_CLEAR:
+            _rx_data_word = 0;
+            break;
+
+        case _SSS_OP_VOTE0:
+            _rx_bit_value = digitalReadFast(rxPin) ^ inverse;
+            break;
+
+        case _SSS_OP_VOTE1:
+            if ((digitalReadFast(rxPin) ^ inverse) != _rx_bit_value) {
+                _rx_hunt();
+            }
+            break;
+
+        case _SSS_OP_SHIFT:
+            _rx_data_word >>= 1;
+            if (_rx_bit_value) {
+                _rx_data_word |= _rx_shiftin_bit;
+            }
+            break;
+
+        case _SSS_OP_STOP:
+            if (digitalReadFast(rxPin) != _stop_level) {
+                _rx_hunt();
+            }
+            break;
+
+        case _SSS_OP_FINAL:
+            if (digitalReadFast(rxPin) == _stop_level
+                    && _rx_write_index - _rx_read_index < rxSize) {
+                _rx_buffer[_rx_write_index & (rxSize - 1)] = _rx_data_word;
+                _SSS_BARRIER();
+                _rx_write_index++;
+            }
+            _rx_hunt();
+            break;
+
+        case _SSS_OP_NULL:
+        default:
+            break;
+    }
+
+}
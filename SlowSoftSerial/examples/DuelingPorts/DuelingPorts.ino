@@ -1,29 +1,29 @@
 #include "SlowSoftSerial.h"
 
-// It's ok to have several SlowSoftSerial objects,
-// but only one can be active at the same time.
+// It's ok to have several SlowSoftSerial objects active at the same time.
+// Each active port uses up to two timers while it's sending or receiving,
+// so on a Teensy with four timers, two ports can be busy at once.
 SlowSoftSerial sss1(0,1);
 SlowSoftSerial sss2(2,3);
 
 void setup() {
   Serial.begin(9600);   // USB port for debug messages
 
+  sss1.begin(9600);
+  sss2.begin(1200);
+  if (!sss1 || !sss2) {
+    Serial.println("Not enough timers for both ports!");
+  }
 }
 
 void loop() {
-  Serial.println("Activating port 1");
-  sss1.begin(9600);
+  Serial.println("Sending on both ports at once");
   sss1.println("This message goes out port 1");
+  sss2.println("Meanwhile on port 2 at a different baud rate!");
   sss1.flush();
-  sss1.end();
-
-  Serial.println("Activating port 2");
-  sss2.begin(1200);
-  sss2.println("Now on port 2 at a different baud rate!");
   sss2.flush();
-  sss2.end();
 
-  Serial.println("Repeating in a few seconds ...);
+  Serial.println("Repeating in a few seconds ...");
   delay(5000);
 
 }